@@ -0,0 +1 @@
+clang++-6.0 ../src/alloc_trace_preload.cpp -std=c++1z -g -Wall -Wextra -Wno-unused-variable -Wno-unused-parameter -Wno-empty-body -DNDEBUG -O3 -fPIC -shared -ldl -lpthread -o liballoc_trace.so
\ No newline at end of file
@@ -0,0 +1 @@
+g++-7 ../src/alloc_trace_preload.cpp -std=c++17 -g -Wall -Wextra -Wno-unused-variable -Wno-unused-parameter -Wno-empty-body -DNDEBUG -O2 -fPIC -shared -ldl -lpthread -o liballoc_trace.so
\ No newline at end of file
@@ -0,0 +1,5 @@
+clang++-6.0 ../src/iibmalloc/iibmalloc_fork_test.cpp -std=c++1z -g -Wall -Wextra -O2 -lpthread -o iibmalloc_fork_test
+# with the purger thread off and on; libiibmalloc.so is built with build_iibmalloc_preload_clang.sh
+LD_PRELOAD=./libiibmalloc.so ./iibmalloc_fork_test && \
+IIBMALLOC_DECOMMIT_DECAY_MS=1000 LD_PRELOAD=./libiibmalloc.so ./iibmalloc_fork_test && \
+IIBMALLOC_UNMAP_DECAY_MS=50 LD_PRELOAD=./libiibmalloc.so ./iibmalloc_fork_test
@@ -0,0 +1 @@
+clang++-6.0 ../src/iibmalloc/iibmalloc_preload.cpp ../src/iibmalloc/page_allocator_linux.cpp -std=c++1z -g -Wall -Wextra -Wno-unused-variable -Wno-unused-parameter -Wno-empty-body -DNDEBUG -O3 -fPIC -shared -ldl -lpthread -o libiibmalloc.so
\ No newline at end of file
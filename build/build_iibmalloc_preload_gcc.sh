@@ -0,0 +1 @@
+g++-7 ../src/iibmalloc/iibmalloc_preload.cpp ../src/iibmalloc/page_allocator_linux.cpp -std=c++17 -g -Wall -Wextra -Wno-unused-variable -Wno-unused-parameter -Wno-empty-body -DNDEBUG -O2 -fPIC -shared -ldl -lpthread -o libiibmalloc.so
\ No newline at end of file
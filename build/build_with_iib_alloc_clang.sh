@@ -1 +1 @@
-clang++-6.0 ../src/test_common.cpp ../src/allocator_tester.cpp ../src/iibmalloc/page_allocator_linux.cpp ../src/iibmalloc/iibmalloc_linux.cpp -std=c++1z -g -Wall -Wextra -Wno-unused-variable -Wno-unused-parameter -Wno-empty-body -DNDEBUG -O3 -flto -lpthread -o tester.bin
\ No newline at end of file
+clang++-6.0 ../src/alloc_trace.cpp ../src/test_common.cpp ../src/test_results.cpp ../src/test_matrix.cpp ../src/allocator_tester.cpp ../src/iibmalloc/page_allocator_linux.cpp ../src/iibmalloc/iibmalloc_linux.cpp -std=c++1z -g -Wall -Wextra -Wno-unused-variable -Wno-unused-parameter -Wno-empty-body -DNDEBUG -O3 -flto -ldl -lpthread -o tester.bin
\ No newline at end of file
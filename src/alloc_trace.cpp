@@ -0,0 +1,260 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- allocation traces
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#include "alloc_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _MSC_VER
+static const uint8_t* mapFileForReading( const char* fileName, size_t& sz )
+{
+	HANDLE hFile = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return nullptr;
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( hFile, &fileSize ) || fileSize.QuadPart == 0 )
+	{
+		CloseHandle( hFile );
+		return nullptr;
+	}
+	HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( hFile );
+	if ( hMapping == NULL )
+		return nullptr;
+	void* ptr = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( hMapping );
+	sz = (size_t)(fileSize.QuadPart);
+	return reinterpret_cast<const uint8_t*>( ptr );
+}
+
+static void unmapFile( const uint8_t* ptr, size_t sz )
+{
+	UnmapViewOfFile( ptr );
+}
+#else
+static const uint8_t* mapFileForReading( const char* fileName, size_t& sz )
+{
+	int fd = open( fileName, O_RDONLY );
+	if ( fd == -1 )
+		return nullptr;
+	struct stat st;
+	if ( fstat( fd, &st ) == -1 || st.st_size == 0 )
+	{
+		::close( fd );
+		return nullptr;
+	}
+	void* ptr = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0 ); // prefaulted, so that replay does not hit page faults of its own
+	::close( fd );
+	if ( ptr == MAP_FAILED )
+		return nullptr;
+	sz = st.st_size;
+	return reinterpret_cast<const uint8_t*>( ptr );
+}
+
+static void unmapFile( const uint8_t* ptr, size_t sz )
+{
+	munmap( const_cast<uint8_t*>( ptr ), sz );
+}
+#endif
+
+
+bool AllocTrace::open( const char* fileName )
+{
+	close();
+	fileData = mapFileForReading( fileName, fileSize );
+	if ( fileData == nullptr )
+	{
+		printf( "failed to map trace file \'%s\'\n", fileName );
+		return false;
+	}
+	if ( fileSize < sizeof( AllocTraceHeader ) )
+	{
+		printf( "trace file \'%s\' is truncated\n", fileName );
+		close();
+		return false;
+	}
+	memcpy( &header, fileData, sizeof( AllocTraceHeader ) );
+	if ( header.magic != alloc_trace_magic || header.version != alloc_trace_version )
+	{
+		printf( "\'%s\' is not a trace file of a supported version\n", fileName );
+		close();
+		return false;
+	}
+
+	// pass 1: validate chunks and count runs per thread
+	firstRunIdx = new size_t[ header.threadCount + 1 ];
+	memset( firstRunIdx, 0, sizeof(size_t) * ( header.threadCount + 1 ) );
+	size_t totalRecords = 0;
+	size_t totalRuns = 0;
+	size_t offset = sizeof( AllocTraceHeader );
+	while ( offset < fileSize )
+	{
+		if ( offset + sizeof( AllocTraceChunkHeader ) > fileSize )
+			break;
+		const AllocTraceChunkHeader* ch = reinterpret_cast<const AllocTraceChunkHeader*>( fileData + offset );
+		if ( ch->threadIdx >= header.threadCount || offset + sizeof( AllocTraceChunkHeader ) + ch->recordCount * sizeof( AllocTraceRecord ) > fileSize )
+			break;
+		++(firstRunIdx[ ch->threadIdx + 1 ]);
+		totalRecords += ch->recordCount;
+		++totalRuns;
+		offset += sizeof( AllocTraceChunkHeader ) + ch->recordCount * sizeof( AllocTraceRecord );
+	}
+	if ( offset != fileSize || totalRecords != header.recordCount )
+	{
+		printf( "trace file \'%s\' is corrupted or truncated (at offset %zd of %zd; %zd of %zd records)\n", fileName, offset, fileSize, totalRecords, (size_t)(header.recordCount) );
+		close();
+		return false;
+	}
+	if ( totalRecords == 0 )
+	{
+		printf( "trace file \'%s\' has no records\n", fileName );
+		close();
+		return false;
+	}
+	for ( size_t i=0; i<header.threadCount; ++i )
+		firstRunIdx[i + 1] += firstRunIdx[i];
+
+	// pass 2: collect runs
+	runs = new Run[ totalRuns ];
+	size_t* nextRunIdx = new size_t[ header.threadCount ];
+	memcpy( nextRunIdx, firstRunIdx, sizeof(size_t) * header.threadCount );
+	offset = sizeof( AllocTraceHeader );
+	while ( offset < fileSize )
+	{
+		const AllocTraceChunkHeader* ch = reinterpret_cast<const AllocTraceChunkHeader*>( fileData + offset );
+		Run& run = runs[ nextRunIdx[ ch->threadIdx ]++ ];
+		run.records = reinterpret_cast<const AllocTraceRecord*>( ch + 1 );
+		run.recordCount = ch->recordCount;
+		offset += sizeof( AllocTraceChunkHeader ) + ch->recordCount * sizeof( AllocTraceRecord );
+	}
+	delete [] nextRunIdx;
+
+	if ( !validateRecords( fileName ) )
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+// a replay indexes objects with IDs as they are and waits for each deallocated object to be allocated (by whichever thread);
+// thus, each object must be allocated once, and deallocated at most once, not before its allocation by the same thread
+bool AllocTrace::validateRecords( const char* fileName ) const
+{
+	constexpr uint32_t no_thread = UINT32_MAX;
+	constexpr uint8_t seen_allocated = 1;
+	constexpr uint8_t seen_deallocated = 2;
+	uint32_t* allocatingThread = new uint32_t[ header.objectCount ];
+	for ( size_t i=0; i<header.objectCount; ++i )
+		allocatingThread[i] = no_thread;
+	uint8_t* seen = new uint8_t[ header.objectCount ]();
+	const char* error = nullptr;
+	size_t errorThreadIdx = 0;
+	size_t errorObjectID = 0;
+
+	// pass 1: IDs, op codes and allocating threads
+	for ( size_t t=0; t<header.threadCount && error == nullptr; ++t )
+		for ( size_t r=firstRunIdx[t]; r<firstRunIdx[t + 1] && error == nullptr; ++r )
+			for ( size_t i=0; i<runs[r].recordCount; ++i )
+			{
+				const AllocTraceRecord& rec = runs[r].records[i];
+				errorThreadIdx = t;
+				errorObjectID = rec.objectID;
+				if ( rec.objectID >= header.objectCount )
+					error = "object ID is out of range";
+				else if ( rec.op != alloc_trace_allocate && rec.op != alloc_trace_deallocate )
+					error = "unknown operation";
+				else if ( rec.op == alloc_trace_allocate && allocatingThread[rec.objectID] != no_thread )
+					error = "object is allocated more than once";
+				else if ( rec.op == alloc_trace_allocate )
+					allocatingThread[rec.objectID] = (uint32_t)t;
+				if ( error != nullptr )
+					break;
+			}
+
+	// pass 2: deallocations, each thread in the order of its records
+	for ( size_t t=0; t<header.threadCount && error == nullptr; ++t )
+		for ( size_t r=firstRunIdx[t]; r<firstRunIdx[t + 1] && error == nullptr; ++r )
+			for ( size_t i=0; i<runs[r].recordCount; ++i )
+			{
+				const AllocTraceRecord& rec = runs[r].records[i];
+				errorThreadIdx = t;
+				errorObjectID = rec.objectID;
+				if ( rec.op == alloc_trace_allocate )
+					seen[rec.objectID] |= seen_allocated;
+				else if ( allocatingThread[rec.objectID] == no_thread )
+					error = "object is deallocated but never allocated";
+				else if ( seen[rec.objectID] & seen_deallocated )
+					error = "object is deallocated more than once";
+				else if ( allocatingThread[rec.objectID] == t && ( seen[rec.objectID] & seen_allocated ) == 0 )
+					error = "object is deallocated before its allocation";
+				else
+					seen[rec.objectID] |= seen_deallocated;
+				if ( error != nullptr )
+					break;
+			}
+
+	delete [] seen;
+	delete [] allocatingThread;
+	if ( error != nullptr )
+	{
+		printf( "trace file \'%s\' cannot be replayed: %s (thread %zd, object %zd)\n", fileName, error, errorThreadIdx, errorObjectID );
+		return false;
+	}
+	return true;
+}
+
+void AllocTrace::close()
+{
+	if ( fileData )
+		unmapFile( fileData, fileSize );
+	fileData = nullptr;
+	fileSize = 0;
+	delete [] runs;
+	runs = nullptr;
+	delete [] firstRunIdx;
+	firstRunIdx = nullptr;
+	memset( &header, 0, sizeof( header ) );
+}
@@ -0,0 +1,129 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- allocation traces
+ * 
+ * Binary trace format (all integers are little-endian, as written by x86/x64):
+ *     AllocTraceHeader
+ *     a sequence of chunks, each being AllocTraceChunkHeader followed by
+ *         AllocTraceChunkHeader::recordCount AllocTraceRecord's of a single thread
+ * Chunks of different threads may be interleaved in any manner; within a thread
+ * records go in the order of occurrence. Object IDs identify a single allocation
+ * (that is, they are never reused) and are less than AllocTraceHeader::objectCount;
+ * an object is allocated once and deallocated at most once, by any thread.
+ * Traces of real processes can be captured with alloc_trace_preload.cpp.
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#ifndef ALLOC_TRACE_H
+#define ALLOC_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+constexpr uint64_t alloc_trace_magic = 0x45434152544d4c41ull; // "ALMTRACE"
+constexpr uint32_t alloc_trace_version = 1;
+
+struct AllocTraceHeader
+{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t threadCount; // thread indexes in chunks are below this value
+	uint64_t objectCount; // object IDs in records are below this value
+	uint64_t recordCount;
+	uint64_t reserved[4];
+};
+static_assert( sizeof( AllocTraceHeader ) == 64, "" );
+
+struct AllocTraceChunkHeader
+{
+	uint32_t threadIdx;
+	uint32_t recordCount;
+};
+static_assert( sizeof( AllocTraceChunkHeader ) == 8, "" );
+
+enum ALLOC_TRACE_OP : uint8_t { alloc_trace_allocate = 0, alloc_trace_deallocate = 1 };
+
+struct AllocTraceRecord
+{
+	uint32_t objectID;
+	uint32_t size; // for deallocations, size of the object being deallocated, if known (or zero)
+	uint32_t tsDelta; // CPU ticks since a previous record of the same thread (saturated at UINT32_MAX)
+	uint16_t threadIdx;
+	uint8_t op; // ALLOC_TRACE_OP
+	uint8_t reserved;
+};
+static_assert( sizeof( AllocTraceRecord ) == 16, "" );
+
+// read-only mapping of a trace file with records of each thread collected (by one pass over chunk headers) into a list of runs;
+// replaying a thread is then a plain loop over AllocTraceRecord arrays
+class AllocTrace
+{
+public:
+	struct Run
+	{
+		const AllocTraceRecord* records;
+		size_t recordCount;
+	};
+
+private:
+	const uint8_t* fileData = nullptr;
+	size_t fileSize = 0;
+	AllocTraceHeader header = {};
+	Run* runs = nullptr; // all runs of thread 0, then of thread 1, etc
+	size_t* firstRunIdx = nullptr; // [threadCount + 1]
+
+	bool validateRecords( const char* fileName ) const;
+
+public:
+	AllocTrace() {}
+	AllocTrace(const AllocTrace&) = delete;
+	AllocTrace& operator=(const AllocTrace&) = delete;
+	~AllocTrace() { close(); }
+
+	bool open( const char* fileName ); // prints a reason and returns false if a file cannot be used
+	void close();
+
+	size_t threadCount() const { return header.threadCount; }
+	size_t objectCount() const { return header.objectCount; }
+	size_t recordCount() const { return header.recordCount; }
+	size_t runCount( size_t threadIdx ) const { assert( threadIdx < header.threadCount ); return firstRunIdx[threadIdx + 1] - firstRunIdx[threadIdx]; }
+	const Run& getRun( size_t threadIdx, size_t runIdx ) const { assert( runIdx < runCount( threadIdx ) ); return runs[ firstRunIdx[threadIdx] + runIdx ]; }
+	size_t threadRecordCount( size_t threadIdx ) const
+	{
+		size_t ret = 0;
+		for ( size_t i=0; i<runCount( threadIdx ); ++i )
+			ret += getRun( threadIdx, i ).recordCount;
+		return ret;
+	}
+};
+
+#endif // ALLOC_TRACE_H
@@ -33,6 +33,43 @@
 
 #include "selector.h"
 #include "allocator_tester.h"
+#include "new_delete_allocator.h"
+#include "iib_allocator.h"
+#include "shared_object_allocator.h"
+#include "test_results.h"
+#include "test_matrix.h"
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+template<class Allocator, bool collectOpLatencies>
+void runRandomTestWithLatencyMode( Allocator& allocator, ThreadStartupParamsAndResults* testParams )
+{
+	switch ( testParams->startupParams.mat )
+	{
+		case MEM_ACCESS_TYPE::none:
+			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::none,collectOpLatencies>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed, testParams->startupParams.idleAfterMainLoopMs );
+			break;
+		case MEM_ACCESS_TYPE::full:
+			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::full,collectOpLatencies>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed, testParams->startupParams.idleAfterMainLoopMs );
+			break;
+		case MEM_ACCESS_TYPE::single:
+			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::single,collectOpLatencies>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed, testParams->startupParams.idleAfterMainLoopMs );
+			break;
+		case MEM_ACCESS_TYPE::check:
+			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::check,collectOpLatencies>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed, testParams->startupParams.idleAfterMainLoopMs );
+			break;
+	}
+}
 
 template<class Allocator>
 void* runRandomTest( void* params )
@@ -40,52 +77,257 @@ void* runRandomTest( void* params )
 	assert( params != nullptr );
 	ThreadStartupParamsAndResults* testParams = reinterpret_cast<ThreadStartupParamsAndResults*>( params );
 	Allocator allocator( testParams->threadRes );
+	if ( testParams->startupParams.collectOpLatencies )
+		runRandomTestWithLatencyMode<Allocator, true>( allocator, testParams );
+	else
+		runRandomTestWithLatencyMode<Allocator, false>( allocator, testParams );
+
+	return nullptr;
+}
+
+template<class Allocator>
+void* runProducerConsumerTest( void* params )
+{
+	assert( params != nullptr );
+	ThreadStartupParamsAndResults* testParams = reinterpret_cast<ThreadStartupParamsAndResults*>( params );
+	assert( testParams->handoffContext != nullptr );
+	HandoffContext& ctx = *(testParams->handoffContext);
+	Allocator allocator( testParams->threadRes );
+	const TestStartupParams& sp = testParams->startupParams;
+	if ( testParams->threadID < sp.threadCount )
+	{
+		switch ( sp.mat )
+		{
+			case MEM_ACCESS_TYPE::none:
+				producerConsumer_Producer<Allocator,MEM_ACCESS_TYPE::none>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, sp.handoffPercent, sp.handoffBatchSize, ctx );
+				break;
+			case MEM_ACCESS_TYPE::full:
+				producerConsumer_Producer<Allocator,MEM_ACCESS_TYPE::full>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, sp.handoffPercent, sp.handoffBatchSize, ctx );
+				break;
+			case MEM_ACCESS_TYPE::single:
+				producerConsumer_Producer<Allocator,MEM_ACCESS_TYPE::single>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, sp.handoffPercent, sp.handoffBatchSize, ctx );
+				break;
+			case MEM_ACCESS_TYPE::check:
+				producerConsumer_Producer<Allocator,MEM_ACCESS_TYPE::check>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, sp.handoffPercent, sp.handoffBatchSize, ctx );
+				break;
+		}
+	}
+	else
+	{
+		size_t consumerIdx = testParams->threadID - sp.threadCount;
+		switch ( sp.mat )
+		{
+			case MEM_ACCESS_TYPE::none:
+				producerConsumer_Consumer<Allocator,MEM_ACCESS_TYPE::none>( allocator, consumerIdx, testParams->threadID, sp.handoffBatchSize, ctx );
+				break;
+			case MEM_ACCESS_TYPE::full:
+				producerConsumer_Consumer<Allocator,MEM_ACCESS_TYPE::full>( allocator, consumerIdx, testParams->threadID, sp.handoffBatchSize, ctx );
+				break;
+			case MEM_ACCESS_TYPE::single:
+				producerConsumer_Consumer<Allocator,MEM_ACCESS_TYPE::single>( allocator, consumerIdx, testParams->threadID, sp.handoffBatchSize, ctx );
+				break;
+			case MEM_ACCESS_TYPE::check:
+				producerConsumer_Consumer<Allocator,MEM_ACCESS_TYPE::check>( allocator, consumerIdx, testParams->threadID, sp.handoffBatchSize, ctx );
+				break;
+		}
+	}
+
+	return nullptr;
+}
+
+template<class Allocator>
+void* runFastPathTest( void* params )
+{
+	assert( params != nullptr );
+	ThreadStartupParamsAndResults* testParams = reinterpret_cast<ThreadStartupParamsAndResults*>( params );
+	Allocator allocator( testParams->threadRes );
+	const TestStartupParams& sp = testParams->startupParams;
+	switch ( sp.mat )
+	{
+		case MEM_ACCESS_TYPE::none:
+			fastPath_SmallSizes<Allocator,MEM_ACCESS_TYPE::none>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+		case MEM_ACCESS_TYPE::full:
+			fastPath_SmallSizes<Allocator,MEM_ACCESS_TYPE::full>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+		case MEM_ACCESS_TYPE::single:
+			fastPath_SmallSizes<Allocator,MEM_ACCESS_TYPE::single>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+		case MEM_ACCESS_TYPE::check:
+			fastPath_SmallSizes<Allocator,MEM_ACCESS_TYPE::check>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+	}
+
+	return nullptr;
+}
+
+template<class Allocator>
+void* runLoadShiftTest( void* params )
+{
+	assert( params != nullptr );
+	ThreadStartupParamsAndResults* testParams = reinterpret_cast<ThreadStartupParamsAndResults*>( params );
+	assert( testParams->loadShiftContext != nullptr );
+	LoadShiftContext& ctx = *(testParams->loadShiftContext);
+	Allocator allocator( testParams->threadRes );
+	const TestStartupParams& sp = testParams->startupParams;
+	switch ( sp.mat )
+	{
+		case MEM_ACCESS_TYPE::none:
+			loadShift_RandomSize<Allocator,MEM_ACCESS_TYPE::none>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, ctx );
+			break;
+		case MEM_ACCESS_TYPE::full:
+			loadShift_RandomSize<Allocator,MEM_ACCESS_TYPE::full>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, ctx );
+			break;
+		case MEM_ACCESS_TYPE::single:
+			loadShift_RandomSize<Allocator,MEM_ACCESS_TYPE::single>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, ctx );
+			break;
+		case MEM_ACCESS_TYPE::check:
+			loadShift_RandomSize<Allocator,MEM_ACCESS_TYPE::check>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed, ctx );
+			break;
+	}
+
+	return nullptr;
+}
+
+template<class Allocator>
+void* runThreadChurnTest( void* params )
+{
+	assert( params != nullptr );
+	ThreadStartupParamsAndResults* testParams = reinterpret_cast<ThreadStartupParamsAndResults*>( params );
+	Allocator allocator( testParams->threadRes );
+	const TestStartupParams& sp = testParams->startupParams;
+	switch ( sp.mat )
+	{
+		case MEM_ACCESS_TYPE::none:
+			threadChurn_RandomSize<Allocator,MEM_ACCESS_TYPE::none>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+		case MEM_ACCESS_TYPE::full:
+			threadChurn_RandomSize<Allocator,MEM_ACCESS_TYPE::full>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+		case MEM_ACCESS_TYPE::single:
+			threadChurn_RandomSize<Allocator,MEM_ACCESS_TYPE::single>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+		case MEM_ACCESS_TYPE::check:
+			threadChurn_RandomSize<Allocator,MEM_ACCESS_TYPE::check>( allocator, sp.iterCount, sp.maxItems, sp.maxItemSize, testParams->threadID, sp.rndSeed );
+			break;
+	}
+
+	return nullptr;
+}
+
+template<class Allocator>
+void* runTraceReplayTest( void* params )
+{
+	assert( params != nullptr );
+	ThreadStartupParamsAndResults* testParams = reinterpret_cast<ThreadStartupParamsAndResults*>( params );
+	assert( testParams->traceReplayContext != nullptr );
+	TraceReplayContext& ctx = *(testParams->traceReplayContext);
+	Allocator allocator( testParams->threadRes );
 	switch ( testParams->startupParams.mat )
 	{
 		case MEM_ACCESS_TYPE::none:
-			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::none>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed );
+			traceReplay<Allocator,MEM_ACCESS_TYPE::none>( allocator, testParams->threadID, ctx );
 			break;
 		case MEM_ACCESS_TYPE::full:
-			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::full>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed );
+			traceReplay<Allocator,MEM_ACCESS_TYPE::full>( allocator, testParams->threadID, ctx );
 			break;
 		case MEM_ACCESS_TYPE::single:
-			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::single>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed );
+			traceReplay<Allocator,MEM_ACCESS_TYPE::single>( allocator, testParams->threadID, ctx );
 			break;
 		case MEM_ACCESS_TYPE::check:
-			randomPos_RandomSize<Allocator,MEM_ACCESS_TYPE::check>( allocator, testParams->startupParams.iterCount, testParams->startupParams.maxItems, testParams->startupParams.maxItemSize, testParams->threadID, testParams->startupParams.rndSeed );
+			traceReplay<Allocator,MEM_ACCESS_TYPE::check>( allocator, testParams->threadID, ctx );
 			break;
 	}
 
 	return nullptr;
 }
 
+inline
+size_t totalThreadCount( const TestStartupParams& params )
+{
+	return params.testType == TEST_TYPE::producer_consumer ? params.threadCount + params.consumerThreadCount : params.threadCount;
+}
+
 template<class Allocator>
 void runTest( TestStartupParamsAndResults* startupParams )
 {
+	AllocTrace trace;
+	TraceReplayContext* traceReplayContext = nullptr;
+	if ( startupParams->startupParams.testType == TEST_TYPE::trace_replay )
+	{
+		if ( !trace.open( startupParams->startupParams.traceFileName ) )
+			throw std::bad_exception();
+		if ( trace.threadCount() == 0 || trace.threadCount() > max_threads )
+		{
+			printf( "trace of %zd threads cannot be replayed (up to %zd threads are supported)\n", trace.threadCount(), max_threads );
+			throw std::bad_exception();
+		}
+		startupParams->startupParams.threadCount = trace.threadCount();
+		traceReplayContext = new TraceReplayContext( &trace );
+	}
+
 	size_t threadCount = startupParams->startupParams.threadCount;
+	size_t totalThreads = totalThreadCount( startupParams->startupParams );
+	assert( totalThreads <= max_threads );
+	size_t opCount = traceReplayContext ? trace.recordCount() : startupParams->startupParams.iterCount * threadCount;
+	if ( startupParams->startupParams.testType == TEST_TYPE::fast_path || startupParams->startupParams.testType == TEST_TYPE::load_shift )
+		opCount *= 2; // each iteration is a deallocation and an allocation
+	else if ( startupParams->startupParams.testType == TEST_TYPE::thread_churn )
+		opCount *= 4 * startupParams->startupParams.maxItems; // each iteration is a thread allocating, replacing and deallocating all of its items
 
+	HandoffContext* handoffContext = nullptr;
+	if ( startupParams->startupParams.testType == TEST_TYPE::producer_consumer )
+	{
+		assert( startupParams->startupParams.consumerThreadCount != 0 );
+		handoffContext = new HandoffContext( threadCount, startupParams->startupParams.consumerThreadCount, startupParams->startupParams.handoffViaSharedRing );
+	}
+	LoadShiftContext* loadShiftContext = nullptr;
+	if ( startupParams->startupParams.testType == TEST_TYPE::load_shift )
+		loadShiftContext = new LoadShiftContext( threadCount );
+
+	LatencyHistogram* latencyHistograms = nullptr; // [0, totalThreads): allocations, then deallocations
+	if ( startupParams->startupParams.collectOpLatencies )
+		latencyHistograms = new LatencyHistogram[ 2 * totalThreads ](); // zeroed
+
+	startupParams->testRes->rssBeforeTest = getRss();
 	size_t start = GetMillisecondCount();
 
 	ThreadStartupParamsAndResults testParams[max_threads];
 	std::thread threads[ max_threads ];
 
-	for ( size_t i=0; i<threadCount; ++i )
+	for ( size_t i=0; i<totalThreads; ++i )
 	{
 		memcpy( testParams + i, startupParams, sizeof(TestStartupParams) );
 		testParams[i].threadID = i;
 		testParams[i].threadRes = startupParams->testRes->threadRes + i;
+		testParams[i].threadRes->allocLatency = latencyHistograms ? latencyHistograms + i : nullptr;
+		testParams[i].threadRes->deallocLatency = latencyHistograms ? latencyHistograms + totalThreads + i : nullptr;
+		testParams[i].handoffContext = handoffContext;
+		testParams[i].traceReplayContext = traceReplayContext;
+		testParams[i].loadShiftContext = loadShiftContext;
 	}
 
 	// run threads
-	for ( size_t i=0; i<threadCount; ++i )
+	for ( size_t i=0; i<totalThreads; ++i )
 	{
 		printf( "about to run thread %zd...\n", i );
-		std::thread t1( runRandomTest<Allocator>, (void*)(testParams + i) );
+		void* (*threadFn)( void* ) = runRandomTest<Allocator>;
+		if ( handoffContext )
+			threadFn = runProducerConsumerTest<Allocator>;
+		else if ( traceReplayContext )
+			threadFn = runTraceReplayTest<Allocator>;
+		else if ( loadShiftContext )
+			threadFn = runLoadShiftTest<Allocator>;
+		else if ( startupParams->startupParams.testType == TEST_TYPE::fast_path )
+			threadFn = runFastPathTest<Allocator>;
+		else if ( startupParams->startupParams.testType == TEST_TYPE::thread_churn )
+			threadFn = runThreadChurnTest<Allocator>;
+		std::thread t1( threadFn, (void*)(testParams + i) );
 		threads[i] = std::move( t1 );
 		printf( "    ...done\n" );
 	}
 	// join threads
-	for ( size_t i=0; i<threadCount; ++i )
+	for ( size_t i=0; i<totalThreads; ++i )
 	{
 		printf( "joining thread %zd...\n", i );
 		threads[i].join();
@@ -93,69 +335,144 @@ void runTest( TestStartupParamsAndResults* startupParams )
 	}
 
 	size_t end = GetMillisecondCount();
-	startupParams->testRes->duration = end - start;
-	printf( "%zd threads made %zd alloc/dealloc operations in %zd ms (%zd ms per 1 million)\n", threadCount, startupParams->startupParams.iterCount * threadCount, end - start, (end - start) * 1000000 / (startupParams->startupParams.iterCount * threadCount) );
+	delete handoffContext;
+	delete traceReplayContext;
+	delete loadShiftContext;
+	size_t idleDur = 0; // threads are idle simultaneously, more or less
+	for ( size_t i=0; i<totalThreads; ++i )
+		if ( idleDur < startupParams->testRes->threadRes[i].idleDur )
+			idleDur = startupParams->testRes->threadRes[i].idleDur;
+	startupParams->testRes->duration = end - start - idleDur;
+	startupParams->testRes->threadCount = totalThreads;
+	printf( "%zd threads made %zd alloc/dealloc operations in %zd ms (%zd ms per 1 million)\n", totalThreads, opCount, startupParams->testRes->duration, startupParams->testRes->duration * 1000000 / opCount );
 	startupParams->testRes->cumulativeDuration = 0;
 	startupParams->testRes->rssMax = 0;
 	startupParams->testRes->allocatedAfterSetupSz = 0;
 	startupParams->testRes->allocatedMax = 0;
-	for ( size_t i=0; i<threadCount; ++i )
+	for ( size_t i=0; i<totalThreads; ++i )
 	{
 		startupParams->testRes->cumulativeDuration += startupParams->testRes->threadRes[i].innerDur;
 		startupParams->testRes->allocatedAfterSetupSz += startupParams->testRes->threadRes[i].allocatedAfterSetupSz;
-		startupParams->testRes->allocatedMax += startupParams->testRes->threadRes[i].allocatedMax;
+		if ( startupParams->startupParams.testType != TEST_TYPE::trace_replay )
+			startupParams->testRes->allocatedMax += startupParams->testRes->threadRes[i].allocatedMax;
+		else if ( startupParams->testRes->allocatedMax < startupParams->testRes->threadRes[i].allocatedMax ) // peaks of the same sum
+			startupParams->testRes->allocatedMax = startupParams->testRes->threadRes[i].allocatedMax;
 		if ( startupParams->testRes->rssMax < startupParams->testRes->threadRes[i].rssMax )
 			startupParams->testRes->rssMax = startupParams->testRes->threadRes[i].rssMax;
 	}
-	startupParams->testRes->cumulativeDuration /= threadCount;
+	startupParams->testRes->cumulativeDuration /= totalThreads;
 	startupParams->testRes->rssAfterExitingAllThreads = getRss();
-}
 
-int main()
-{ 
-	TestRes testResMyAlloc[max_threads];
-	TestRes testResVoidAlloc[max_threads];
-	memset( testResMyAlloc, 0, sizeof( testResMyAlloc ) );
-	memset( testResVoidAlloc, 0, sizeof( testResVoidAlloc ) );
-
-	size_t maxItems = 1 << 25;
-	TestStartupParamsAndResults params;
-	params.startupParams.iterCount = 100000000;
-	params.startupParams.maxItemSize = 16;
-//		params.startupParams.maxItems = 23 << 20;
-	params.startupParams.mat = MEM_ACCESS_TYPE::full;
-
-	size_t threadMin = 1;
-	size_t threadMax = 23;
+	memset( &(startupParams->testRes->allocLatency), 0, sizeof( LatencyPercentiles ) );
+	memset( &(startupParams->testRes->deallocLatency), 0, sizeof( LatencyPercentiles ) );
+	if ( latencyHistograms )
+	{
+		for ( size_t i=1; i<totalThreads; ++i )
+		{
+			latencyHistograms[0].merge( latencyHistograms[i] );
+			latencyHistograms[totalThreads].merge( latencyHistograms[totalThreads + i] );
+		}
+		startupParams->testRes->allocLatency.set( latencyHistograms[0] );
+		startupParams->testRes->deallocLatency.set( latencyHistograms[totalThreads] );
+		for ( size_t i=0; i<totalThreads; ++i )
+		{
+			startupParams->testRes->threadRes[i].allocLatency = nullptr;
+			startupParams->testRes->threadRes[i].deallocLatency = nullptr;
+		}
+		delete [] latencyHistograms;
+	}
 
-	for ( params.startupParams.threadCount=threadMin; params.startupParams.threadCount<=threadMax; ++(params.startupParams.threadCount) )
+	startupParams->testRes->perfCountersAvailable = UINT32_MAX;
+	startupParams->testRes->mainLoopOpCount = 0;
+	memset( startupParams->testRes->perfPhase, 0, sizeof( startupParams->testRes->perfPhase ) );
+	for ( size_t i=0; i<totalThreads; ++i )
 	{
-		params.startupParams.maxItems = maxItems / params.startupParams.threadCount;
-		params.testRes = testResMyAlloc + params.startupParams.threadCount;
-		runTest<MyAllocatorT>( &params );
+		const ThreadTestRes& res = startupParams->testRes->threadRes[i];
+		startupParams->testRes->perfCountersAvailable &= res.perfCountersAvailable;
+		startupParams->testRes->mainLoopOpCount += res.mainLoopOpCount;
+		for ( size_t phase=0; phase<test_phase_count; ++phase )
+			for ( size_t c=0; c<perf_counter_count; ++c )
+				startupParams->testRes->perfPhase[phase].values[c] += perfCounterPhaseValue( res, phase, c );
+	}
+}
 
-		if ( params.startupParams.mat != MEM_ACCESS_TYPE::check )
+void printPerfCountersSummary( TestRes* testRes, ThreadCountSet idxs )
+{
+	uint32_t available = UINT32_MAX;
+	for ( size_t idx : idxs )
+		available &= testRes[idx].perfCountersAvailable;
+	if ( available == 0 )
+		return;
+	printf( "Performance counters (all threads merged; totals per phase and per operation of the main loop):\n" );
+	printf( "columns:\n" );
+	printf( "threads" );
+	for ( size_t c=0; c<perf_counter_count; ++c )
+		if ( available & ( 1 << c ) )
 		{
-			params.startupParams.maxItems = maxItems / params.startupParams.threadCount;
-			params.testRes = testResVoidAlloc + params.startupParams.threadCount;
-			runTest<VoidAllocatorForTest<MyAllocatorT>>( &params );
+			for ( size_t phase=0; phase<test_phase_count; ++phase )
+				printf( ",%s %s", perf_counter_names[c], test_phase_names[phase] );
+			printf( ",%s per op", perf_counter_names[c] );
 		}
+	printf( "\n" );
+	for ( size_t idx : idxs )
+	{
+		const TestRes& tr = testRes[idx];
+		printf( "%zd", tr.threadCount );
+		for ( size_t c=0; c<perf_counter_count; ++c )
+			if ( available & ( 1 << c ) )
+			{
+				for ( size_t phase=0; phase<test_phase_count; ++phase )
+					printf( ",%zd", (size_t)(tr.perfPhase[phase].values[c]) );
+				printf( ",%f", tr.mainLoopOpCount ? tr.perfPhase[1].values[c] * 1. / tr.mainLoopOpCount : 0. );
+			}
+		printf( "\n" );
 	}
+}
 
+// CPU ticks of main loops of all threads per main loop operation
+static double mainLoopTicksPerOp( const TestRes& tr )
+{
+	uint64_t ticks = 0;
+	for ( size_t i=0; i<tr.threadCount; ++i )
+		ticks += tr.threadRes[i].rdtscMainLoop - tr.threadRes[i].rdtscSetup;
+	return tr.mainLoopOpCount ? ticks * 1. / tr.mainLoopOpCount : 0.;
+}
+
+void printTestSummary( const char* allocatorName, TestStartupParamsAndResults& params, TestRes* testResMyAlloc, TestRes* testResVoidAlloc, size_t maxItems, ThreadCountSet threadCounts )
+{
 	if ( params.startupParams.mat == MEM_ACCESS_TYPE::check )
 	{
 		printf( "Correctness test has been passed successfully\n" );
-		return 0;
+		return;
+	}
+
+	if ( params.startupParams.testType == TEST_TYPE::trace_replay )
+	{
+		TestRes& trVoid = testResVoidAlloc[0];
+		TestRes& trMy = testResMyAlloc[0];
+		printf( "Test summary for \'%s\' replaying \'%s\' (%zd threads):\n", allocatorName, params.startupParams.traceFileName, params.startupParams.threadCount );
+		printf( "Per-thread stats:\n" );
+		for ( size_t i=0;i<params.startupParams.threadCount;++i )
+		{
+			printf( "   %zd:\n", i );
+			printThreadStats( "\t", trMy.threadRes[i] );
+		}
+		printf( "columns:\n" );
+		printf( "threads,duration(ms),duration of void(ms),diff(ms),RSS before test(pages),RSS max(pages),rssAfterExitingAllThreads(pages),RSS max for void(pages)\n" );
+		printf( "%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd\n", params.startupParams.threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration, trMy.rssBeforeTest, trMy.rssMax, trMy.rssAfterExitingAllThreads, trVoid.rssMax );
+		printPerfCountersSummary( testResMyAlloc, ThreadCountSet::only( 0 ) );
+		return;
 	}
 
 	printf( "Test summary:\n" );
-	for ( size_t threadCount=threadMin; threadCount<=threadMax; ++threadCount )
+	for ( size_t threadCount : threadCounts )
 	{
 		TestRes& trVoid = testResVoidAlloc[threadCount];
 		TestRes& trMy = testResMyAlloc[threadCount];
 		printf( "%zd,%zd,%zd,%zd\n", threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration );
 		printf( "Per-thread stats:\n" );
-		for ( size_t i=0;i<threadCount;++i )
+		size_t totalThreads = params.startupParams.testType == TEST_TYPE::producer_consumer ? threadCount + params.startupParams.consumerThreadCount : threadCount;
+		for ( size_t i=0;i<totalThreads;++i )
 		{
 			printf( "   %zd:\n", i );
 			printThreadStats( "\t", trMy.threadRes[i] );
@@ -163,24 +480,551 @@ int main()
 	}
 	printf( "\n" );
 	const char* memAccessTypeStr = params.startupParams.mat == MEM_ACCESS_TYPE::none ? "none" : ( params.startupParams.mat == MEM_ACCESS_TYPE::single ? "single" : ( params.startupParams.mat == MEM_ACCESS_TYPE::full ? "full" : "unknown" ) );
-	printf( "Short test summary for \'%s\' and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s:\n", MyAllocatorT::name(), params.startupParams.maxItemSize, maxItems, params.startupParams.iterCount, memAccessTypeStr );
+	if ( params.startupParams.testType == TEST_TYPE::producer_consumer )
+	{
+		printf( "Short test summary for \'%s\' (producer/consumer with %zd consumer(s), handoff = %zd%% in batches of %zd via %s) and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s:\n", allocatorName, params.startupParams.consumerThreadCount, params.startupParams.handoffPercent, params.startupParams.handoffBatchSize, params.startupParams.handoffViaSharedRing ? "shared MPMC ring" : "SPSC rings", params.startupParams.maxItemSize, maxItems, params.startupParams.iterCount, memAccessTypeStr );
+		printf( "columns:\n" );
+		printf( "producers,duration(ms),duration of void(ms),diff(ms),throughput(alloc/dealloc pairs per ms),RSS before test(pages),RSS max(pages),RSS growth(pages),rssAfterExitingAllThreads(pages),RSS max for void(pages)\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			TestRes& trVoid = testResVoidAlloc[threadCount];
+			TestRes& trMy = testResMyAlloc[threadCount];
+			printf( "%zd,%zd,%zd,%zd,%f,%zd,%zd,%zd,%zd,%zd\n", threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration, params.startupParams.iterCount * threadCount * 1. / trMy.duration, trMy.rssBeforeTest, trMy.rssMax, trMy.rssMax - trMy.rssBeforeTest, trMy.rssAfterExitingAllThreads, trVoid.rssMax );
+		}
+		printPerfCountersSummary( testResMyAlloc, threadCounts );
+		return;
+	}
+
+	if ( params.startupParams.testType == TEST_TYPE::load_shift )
+	{
+		printf( "Short test summary for \'%s\' (load shift) and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s:\n", allocatorName, params.startupParams.maxItemSize, maxItems, params.startupParams.iterCount, memAccessTypeStr );
+		printf( "columns:\n" );
+		printf( "threads,duration(ms),duration of void(ms),diff(ms),RSS before test(pages),RSS max(pages),RSS growth(pages),RSS after all turns(pages),RSS max for void(pages)\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			TestRes& trVoid = testResVoidAlloc[threadCount];
+			TestRes& trMy = testResMyAlloc[threadCount];
+			printf( "%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd\n", threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration, trMy.rssBeforeTest, trMy.rssMax, trMy.rssMax - trMy.rssBeforeTest, trMy.threadRes[threadCount - 1].rssAfterTurn, trVoid.rssMax );
+		}
+		printf( "RSS after each turn (pages; memory left with idle heaps adds up here) vs. page faults of the main loop (what it saves when reused):\n" );
+		printf( "columns:\n" );
+		printf( "threads,page faults main loop,RSS after turn of thread 0,...\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			const TestRes& trMy = testResMyAlloc[threadCount];
+			printf( "%zd,", threadCount );
+			if ( trMy.perfCountersAvailable & ( 1 << perf_page_faults ) )
+				printf( "%zd", (size_t)(trMy.perfPhase[1].values[perf_page_faults]) );
+			for ( size_t i=0; i<threadCount; ++i )
+				printf( ",%zd", trMy.threadRes[i].rssAfterTurn );
+			printf( "\n" );
+		}
+		printPerfCountersSummary( testResMyAlloc, threadCounts );
+		return;
+	}
+
+	if ( params.startupParams.testType == TEST_TYPE::thread_churn )
+	{
+		printf( "Short test summary for \'%s\' (thread churn) and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s:\n", allocatorName, params.startupParams.maxItemSize, maxItems, params.startupParams.iterCount, memAccessTypeStr );
+		printf( "columns:\n" );
+		printf( "threads,duration(ms),duration of void(ms),diff(ms),threads started,diff per thread started(us),RSS max(pages),RSS max for void(pages)\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			TestRes& trVoid = testResVoidAlloc[threadCount];
+			TestRes& trMy = testResMyAlloc[threadCount];
+			size_t started = trMy.mainLoopOpCount / ( 4 * ( maxItems / threadCount ) ); // by all threads, as counted by them
+			printf( "%zd,%zd,%zd,%zd,%zd,%f,%zd,%zd\n", threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration, started, started ? ( (double)trMy.duration - (double)trVoid.duration ) * 1000. * threadCount / started : 0., trMy.rssMax, trVoid.rssMax );
+		}
+		printPerfCountersSummary( testResMyAlloc, threadCounts );
+		return;
+	}
+
+	if ( params.startupParams.testType == TEST_TYPE::fast_path )
+	{
+		printf( "Short test summary for \'%s\' (fast path) and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s:\n", allocatorName, params.startupParams.maxItemSize, maxItems, params.startupParams.iterCount, memAccessTypeStr );
+		printf( "columns:\n" );
+		printf( "thread,duration(ms),duration of void(ms),diff(ms),ticks per op,ticks per op for void,diff(ticks per op),RSS max(pages)\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			TestRes& trVoid = testResVoidAlloc[threadCount];
+			TestRes& trMy = testResMyAlloc[threadCount];
+			double ticksMy = mainLoopTicksPerOp( trMy );
+			double ticksVoid = mainLoopTicksPerOp( trVoid );
+			printf( "%zd,%zd,%zd,%zd,%f,%f,%f,%zd\n", threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration, ticksMy, ticksVoid, ticksMy - ticksVoid, trMy.rssMax );
+		}
+		printPerfCountersSummary( testResMyAlloc, threadCounts );
+		return;
+	}
+
+	printf( "Short test summary for \'%s\' and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s:\n", allocatorName, params.startupParams.maxItemSize, maxItems, params.startupParams.iterCount, memAccessTypeStr );
 	printf( "columns:\n" );
 	printf( "thread,duration(ms),duration of void(ms),diff(ms),RSS max(pages),rssAfterExitingAllThreads(pages),RSS max for void(pages),rssAfterExitingAllThreads for void(pages),allocatedAfterSetup(app level,bytes),allocatedMax(app level,bytes),(RSS max<<12)/allocatedMax\n" );
-	for ( size_t threadCount=threadMin; threadCount<=threadMax; ++threadCount )
+	for ( size_t threadCount : threadCounts )
 	{
 		TestRes& trVoid = testResVoidAlloc[threadCount];
 		TestRes& trMy = testResMyAlloc[threadCount];
 		printf( "%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%f\n", threadCount, trMy.duration, trVoid.duration, trMy.duration - trVoid.duration, trMy.rssMax, trMy.rssAfterExitingAllThreads, trVoid.rssMax, trVoid.rssAfterExitingAllThreads, trMy.allocatedAfterSetupSz, trMy.allocatedMax, (trMy.rssMax << 12) * 1. / trMy.allocatedMax );
 
 	}
+	if ( params.startupParams.collectOpLatencies )
+	{
+		printf( "Per-operation latencies (in CPU ticks, all threads merged):\n" );
+		printf( "columns:\n" );
+		printf( "thread,allocations,alloc p50,alloc p99,alloc p99.9,alloc p99.99,alloc max,deallocations,dealloc p50,dealloc p99,dealloc p99.9,dealloc p99.99,dealloc max\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			const LatencyPercentiles& a = testResMyAlloc[threadCount].allocLatency;
+			const LatencyPercentiles& d = testResMyAlloc[threadCount].deallocLatency;
+			printf( "%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd\n", threadCount, a.opCount, a.p50, a.p99, a.p999, a.p9999, a.max, d.opCount, d.p50, d.p99, d.p999, d.p9999, d.max );
+		}
+	}
+	if ( params.startupParams.idleAfterMainLoopMs )
+	{
+		printf( "RSS during idle phase (pages, as seen by thread 0; %zd ms between samples):\n", params.startupParams.idleAfterMainLoopMs / ( idle_rss_sample_count - 1 ) );
+		printf( "columns:\n" );
+		printf( "thread,RSS max,RSS at idle samples...,RSS max for void\n" );
+		for ( size_t threadCount : threadCounts )
+		{
+			const TestRes& trMy = testResMyAlloc[threadCount];
+			printf( "%zd,%zd", threadCount, trMy.rssMax );
+			for ( size_t i=0; i<idle_rss_sample_count; ++i )
+				printf( ",%zd", trMy.threadRes[0].rssDuringIdle[i] );
+			printf( ",%zd\n", testResVoidAlloc[threadCount].rssMax );
+		}
+	}
+	printPerfCountersSummary( testResMyAlloc, threadCounts );
 /*	printf( "Short test summary for USE_RANDOMPOS_RANDOMSIZE (alt computations):\n" );
-	for ( size_t threadCount=threadMin; threadCount<=threadMax; ++threadCount )
+	for ( size_t threadCount : threadCounts )
 	{
 		TestRes& trVoid = testResVoidAlloc[threadCount];
 		TestRes& trMy = testResMyAlloc[threadCount];
 		printf( "%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%zd,%f\n", threadCount, trMy.cumulativeDuration, trVoid.cumulativeDuration, trMy.cumulativeDuration - trVoid.cumulativeDuration, trMy.rssMax, trMy.rssAfterExitingAllThreads, trVoid.rssMax, trVoid.rssAfterExitingAllThreads, trMy.allocatedAfterSetupSz, trMy.allocatedMax, (trMy.rssMax << 12) * 1. / trMy.allocatedMax );
 	}*/
+}
 
-	return 0;
+template<class Allocator>
+void runTestSeries( TestStartupParamsAndResults& params, TestRes* testResMyAlloc, TestRes* testResVoidAlloc, size_t maxItems, ThreadCountSet threadCounts )
+{
+	if ( params.startupParams.testType == TEST_TYPE::trace_replay )
+	{
+		// a number of threads is defined by a trace
+		params.startupParams.threadCount = 0;
+		params.testRes = testResMyAlloc + 0;
+		runTest<Allocator>( &params );
+		if ( params.startupParams.mat != MEM_ACCESS_TYPE::check )
+		{
+			params.testRes = testResVoidAlloc + 0;
+			runTest<VoidAllocatorForTest<Allocator>>( &params );
+		}
+	}
+	else
+	{
+		for ( size_t threadCount : threadCounts )
+		{
+			params.startupParams.threadCount = threadCount;
+			params.startupParams.maxItems = params.startupParams.testType == TEST_TYPE::load_shift ? maxItems : maxItems / params.startupParams.threadCount; // each thread runs its load_shift turn alone
+			params.testRes = testResMyAlloc + params.startupParams.threadCount;
+			runTest<Allocator>( &params );
+
+			if ( params.startupParams.mat != MEM_ACCESS_TYPE::check )
+			{
+				params.startupParams.maxItems = params.startupParams.testType == TEST_TYPE::load_shift ? maxItems : maxItems / params.startupParams.threadCount;
+				params.testRes = testResVoidAlloc + params.startupParams.threadCount;
+				runTest<VoidAllocatorForTest<Allocator>>( &params );
+			}
+		}
+	}
+
+	printTestSummary( Allocator::name(), params, testResMyAlloc, testResVoidAlloc, maxItems, threadCounts );
+}
+
+typedef void (*RunTestSeriesFn)( TestStartupParamsAndResults& params, TestRes* testResMyAlloc, TestRes* testResVoidAlloc, size_t maxItems, ThreadCountSet threadCounts );
+
+struct AllocatorForTestEntry
+{
+	const char* name; // as specified in a command line
+	RunTestSeriesFn runTestSeries;
+	bool (*load)( const char* path ); // nullptr for built-in allocators
+};
+
+static const AllocatorForTestEntry builtInAllocators[] = {
+	{ "new-delete", runTestSeries<NewDeleteAllocatorForTest>, nullptr },
+	{ "iibmalloc", runTestSeries<IibmallocAllocatorForTest>, nullptr },
+	{ "iibmalloc-thp", runTestSeries<IibmallocHugePagesAllocatorForTest>, nullptr },
+	{ "iibmalloc-exp", runTestSeries<IibmallocExpAllocatorForTest>, nullptr },
+	{ "iibmalloc-quarter-exp", runTestSeries<IibmallocQuarterExpAllocatorForTest>, nullptr },
+	{ "iibmalloc-table", runTestSeries<IibmallocTableAllocatorForTest>, nullptr },
+	{ "iibmalloc-exp-table", runTestSeries<IibmallocExpTableAllocatorForTest>, nullptr },
+	{ "iibmalloc-quarter-exp-table", runTestSeries<IibmallocQuarterExpTableAllocatorForTest>, nullptr },
+	{ "iibmalloc-lazy", runTestSeries<IibmallocLazyAllocatorForTest>, nullptr },
+	{ "iibmalloc-large-buckets", runTestSeries<IibmallocLargeBucketsAllocatorForTest>, nullptr },
+	{ "iibmalloc-adopt", runTestSeries<IibmallocAdoptingAllocatorForTest>, nullptr },
+};
+static const AllocatorForTestEntry sharedObjectAllocator = { "<shared object>", runTestSeries<SharedObjectAllocatorForTest>, SharedObjectAllocatorForTest::load };
+
+static const AllocatorForTestEntry selectorAllocator = { "selector.h", runTestSeries<MyAllocatorT>, nullptr };
+
+struct AllocatorToCompare
+{
+	const AllocatorForTestEntry* entry;
+	const char* arg; // a name of a built-in allocator or a path to a shared object
+};
+constexpr size_t max_allocators_to_compare = 32;
+
+static void addAllocatorToCompare( AllocatorToCompare* allocs, size_t& allocCount, const AllocatorForTestEntry* entry, const char* arg )
+{
+	if ( allocCount == max_allocators_to_compare )
+	{
+		printf( "too many allocators to compare; '%s' is ignored\n", arg );
+		return;
+	}
+	allocs[allocCount].entry = entry;
+	allocs[allocCount].arg = arg;
+	++allocCount;
+}
+
+// a built-in allocator name, a path to a shared object, or a directory to take all *.so from
+static void parseAllocatorArg( AllocatorToCompare* allocs, size_t& allocCount, const char* arg )
+{
+	for ( size_t i=0; i<sizeof(builtInAllocators)/sizeof(builtInAllocators[0]); ++i )
+		if ( strcmp( arg, builtInAllocators[i].name ) == 0 )
+		{
+			addAllocatorToCompare( allocs, allocCount, builtInAllocators + i, arg );
+			return;
+		}
+#ifndef _MSC_VER
+	struct stat st;
+	if ( stat( arg, &st ) == 0 && S_ISDIR( st.st_mode ) )
+	{
+		DIR* dir = opendir( arg );
+		if ( dir == nullptr )
+			return;
+		while ( struct dirent* de = readdir( dir ) )
+		{
+			size_t len = strlen( de->d_name );
+			if ( len > 3 && strcmp( de->d_name + len - 3, ".so" ) == 0 )
+			{
+				char* path = new char[ strlen( arg ) + len + 2 ]; // lives until exit
+				sprintf( path, "%s/%s", arg, de->d_name );
+				addAllocatorToCompare( allocs, allocCount, &sharedObjectAllocator, path );
+			}
+		}
+		closedir( dir );
+		return;
+	}
+#endif
+	addAllocatorToCompare( allocs, allocCount, &sharedObjectAllocator, arg );
+}
+
+// a single allocator at a single point of a test matrix
+struct TestRun
+{
+	const AllocatorForTestEntry* entry;
+	const char* arg;
+	TestStartupParams params; // maxItems is a total for all threads
+	ThreadCountSet threadCounts;
+	bool succeeded;
+	bool resShared; // with a child process
+	TestRes* testResMyAlloc; // [max_threads]
+	TestRes* testResVoidAlloc;
+
+	AllocatorTestResults results() const { return { arg, params, threadCounts, succeeded, testResMyAlloc, testResVoidAlloc }; }
+};
+
+static void runTestSeriesInProcess( TestRun& run )
+{
+	run.testResMyAlloc = new TestRes[ max_threads ]();
+	run.testResVoidAlloc = new TestRes[ max_threads ]();
+	run.resShared = false;
+	if ( run.entry->load != nullptr && !run.entry->load( run.arg ) )
+		return;
+	TestStartupParamsAndResults params;
+	params.startupParams = run.params;
+	run.entry->runTestSeries( params, run.testResMyAlloc, run.testResVoidAlloc, run.params.maxItems, run.threadCounts );
+	run.succeeded = true;
+}
+
+// each allocator is tested in a process of its own, so that neither heaps nor RSS figures of different allocators interfere
+static void runTestSeriesInChildProcess( TestRun& run )
+{
+	printf( "testing allocator '%s'...\n", run.arg );
+#ifdef _MSC_VER
+	runTestSeriesInProcess( run );
+#else
+	size_t sz = 2 * max_threads * sizeof( TestRes );
+	void* shared = mmap( nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 ); // zeroed
+	if ( shared == MAP_FAILED )
+		throw std::bad_alloc();
+	run.testResMyAlloc = reinterpret_cast<TestRes*>( shared );
+	run.testResVoidAlloc = run.testResMyAlloc + max_threads;
+	run.resShared = true;
+
+	fflush( stdout );
+	pid_t pid = fork();
+	if ( pid == -1 )
+	{
+		printf( "fork() failed, error = %d\n", errno );
+		return;
+	}
+	if ( pid == 0 )
+	{
+		int exitCode = 2;
+		if ( run.entry->load == nullptr || run.entry->load( run.arg ) )
+		{
+			TestStartupParamsAndResults params;
+			params.startupParams = run.params;
+			try
+			{
+				run.entry->runTestSeries( params, run.testResMyAlloc, run.testResVoidAlloc, run.params.maxItems, run.threadCounts );
+				exitCode = 0;
+			}
+			catch ( const std::bad_alloc& )
+			{
+				printf( "out of memory\n" );
+			}
+			catch ( ... ) {} // a reason is already printed (e.g. by AllocTrace::open())
+		}
+		fflush( stdout );
+		_exit( exitCode );
+	}
+	int status = 0;
+	while ( waitpid( pid, &status, 0 ) == -1 && errno == EINTR )
+		;
+	run.succeeded = WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+	if ( !run.succeeded )
+		printf( "testing allocator '%s' failed (%s %d)\n", run.arg, WIFSIGNALED( status ) ? "signal" : "exit code", WIFSIGNALED( status ) ? WTERMSIG( status ) : WEXITSTATUS( status ) );
+#endif
+}
+
+static void releaseTestRun( TestRun& run )
+{
+#ifndef _MSC_VER
+	if ( run.resShared )
+	{
+		munmap( run.testResMyAlloc, 2 * max_threads * sizeof( TestRes ) );
+		run.testResMyAlloc = run.testResVoidAlloc = nullptr;
+		return;
+	}
+#endif
+	delete [] run.testResMyAlloc;
+	delete [] run.testResVoidAlloc;
+	run.testResMyAlloc = run.testResVoidAlloc = nullptr;
+}
+
+static void printComparison( const TestRun* runs, size_t runCount )
+{
+	const TestStartupParams& startupParams = runs[0].params;
+	printf( "\nComparison of allocators:\n" );
+	for ( size_t i=0; i<runCount; ++i )
+		printf( "   %zd: '%s'%s\n", i, runs[i].arg, runs[i].succeeded ? "" : " (FAILED)" );
+	if ( startupParams.mat == MEM_ACCESS_TYPE::check )
+		return;
+	printf( "columns:\n" );
+	printf( "threads" );
+	for ( size_t i=0; i<runCount; ++i )
+		printf( ",%zd: diff(ms),%zd: RSS max(pages),%zd: dTLB misses per op", i, i, i );
+	printf( "\n" );
+	ThreadCountSet threadCounts = runs[0].threadCounts;
+	if ( startupParams.testType == TEST_TYPE::trace_replay )
+		threadCounts = ThreadCountSet::only( 0 ); // a single run with a number of threads defined by a trace
+	for ( size_t threadCount : threadCounts )
+	{
+		printf( "%zd", threadCount == 0 ? runs[0].testResMyAlloc[0].threadCount : threadCount );
+		for ( size_t i=0; i<runCount; ++i )
+		{
+			if ( !runs[i].succeeded )
+			{
+				printf( ",,," );
+				continue;
+			}
+			TestRes& trVoid = runs[i].testResVoidAlloc[threadCount];
+			TestRes& trMy = runs[i].testResMyAlloc[threadCount];
+			printf( ",%zd,%zd,", trMy.duration - trVoid.duration, trMy.rssMax );
+			if ( ( trMy.perfCountersAvailable & ( 1 << perf_dtlb_misses ) ) && trMy.mainLoopOpCount )
+				printf( "%f", trMy.perfPhase[1].values[perf_dtlb_misses] * 1. / trMy.mainLoopOpCount );
+		}
+		printf( "\n" );
+	}
 }
 
+static const char* memAccessTypeName( MEM_ACCESS_TYPE mat )
+{
+	switch ( mat )
+	{
+		case MEM_ACCESS_TYPE::none: return "none";
+		case MEM_ACCESS_TYPE::single: return "single";
+		case MEM_ACCESS_TYPE::full: return "full";
+		case MEM_ACCESS_TYPE::check: return "check";
+	}
+	return "unknown";
+}
+
+static void appendSanitized( std::string& str, const char* part )
+{
+	for ( ; *part; ++part )
+		str += isalnum( (unsigned char)*part ) || *part == '-' ? *part : '_';
+}
+
+// unique for an allocator and all startup parameters but the number of threads, which is in a mask
+static std::string testRunFileName( const char* outDir, const TestRun& run )
+{
+	const TestStartupParams& p = run.params;
+	std::string name = outDir;
+	name += "/";
+	appendSanitized( name, run.arg );
+	char buff[256];
+	switch ( p.testType )
+	{
+		case TEST_TYPE::random_pos_random_size:
+			snprintf( buff, sizeof( buff ), "_rnd_t%llx%s", (unsigned long long)run.threadCounts.asMask(), p.collectOpLatencies ? "_lat" : "" );
+			if ( p.idleAfterMainLoopMs )
+				snprintf( buff + strlen( buff ), sizeof( buff ) - strlen( buff ), "_idle%zd", p.idleAfterMainLoopMs );
+			break;
+		case TEST_TYPE::producer_consumer:
+			snprintf( buff, sizeof( buff ), "_pc_t%llx_c%zd_h%zd_b%zd%s", (unsigned long long)run.threadCounts.asMask(), p.consumerThreadCount, p.handoffPercent, p.handoffBatchSize, p.handoffViaSharedRing ? "_shared" : "" );
+			break;
+		case TEST_TYPE::trace_replay:
+			snprintf( buff, sizeof( buff ), "_trace_" );
+			break;
+		case TEST_TYPE::fast_path:
+			snprintf( buff, sizeof( buff ), "_fast_t%llx", (unsigned long long)run.threadCounts.asMask() );
+			break;
+		case TEST_TYPE::load_shift:
+			snprintf( buff, sizeof( buff ), "_shift_t%llx", (unsigned long long)run.threadCounts.asMask() );
+			break;
+		case TEST_TYPE::thread_churn:
+			snprintf( buff, sizeof( buff ), "_churn_t%llx", (unsigned long long)run.threadCounts.asMask() );
+			break;
+	}
+	name += buff;
+	if ( p.testType == TEST_TYPE::trace_replay )
+		appendSanitized( name, p.traceFileName );
+	snprintf( buff, sizeof( buff ), "_e%zd_n%zd_i%zd_%s_s%zd.json", p.maxItemSize, p.maxItems, p.iterCount, memAccessTypeName( p.mat ), p.rndSeed );
+	name += buff;
+	return name;
+}
+
+static bool fileExists( const char* fileName )
+{
+	FILE* f = fopen( fileName, "rb" );
+	if ( f == nullptr )
+		return false;
+	fclose( f );
+	return true;
+}
+
+// see printTestMatrixUsage() for arguments
+int main( int argc, char** argv )
+{ 
+	if ( argc >= 4 && strcmp( argv[1], "--compare" ) == 0 )
+	{
+		int regressions = compareTestResults( argv[2], argv[3], argc >= 5 ? atof( argv[4] ) : 5. );
+		return regressions == 0 ? 0 : ( regressions > 0 ? 1 : 2 );
+	}
+	if ( argc >= 2 && strcmp( argv[1], "--help" ) == 0 )
+	{
+		printTestMatrixUsage();
+		return 0;
+	}
+
+	TestMatrix matrix;
+	initTestMatrix( matrix );
+	if ( !parseTestMatrixArgs( matrix, argc, argv ) )
+	{
+		printTestMatrixUsage();
+		return 2;
+	}
+
+	AllocatorToCompare allocs[max_allocators_to_compare];
+	size_t allocCount = 0;
+	for ( const char* arg : matrix.allocators )
+		parseAllocatorArg( allocs, allocCount, arg );
+	bool inProcess = matrix.allocators.empty(); // just an allocator defined in selector.h
+	if ( inProcess )
+		addAllocatorToCompare( allocs, allocCount, &selectorAllocator, MyAllocatorT::name() );
+	if ( allocCount == 0 )
+	{
+		printf( "no allocators to test\n" );
+		return 2;
+	}
+
+	ThreadCountSet threadCounts = matrix.threadCounts;
+	if ( matrix.base.testType == TEST_TYPE::producer_consumer )
+		threadCounts.removeAbove( max_threads - matrix.base.consumerThreadCount );
+	if ( threadCounts.empty() )
+	{
+		printf( "no thread counts to test\n" );
+		return 2;
+	}
+	if ( !checkItemsPerThread( matrix, threadCounts ) )
+		return 2;
+	if ( matrix.outDir != nullptr )
+	{
+#ifdef _MSC_VER
+		_mkdir( matrix.outDir );
+#else
+		mkdir( matrix.outDir, 0777 );
+#endif
+	}
+
+	std::vector<TestRun> allRuns; // for matrix.resultsFileName
+	size_t pointCount = matrix.pointCount();
+	for ( size_t pt=0; pt<pointCount; ++pt )
+	{
+		TestStartupParams params;
+		matrix.getPoint( pt, params );
+		if ( pointCount > 1 )
+			printf( "\nTest matrix point %zd of %zd: maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s, rndSeed = %zd\n", pt + 1, pointCount, params.maxItemSize, params.maxItems, params.iterCount, memAccessTypeName( params.mat ), params.rndSeed );
+
+		std::vector<TestRun> runs;
+		for ( size_t i=0; i<allocCount; ++i )
+		{
+			TestRun run = { allocs[i].entry, allocs[i].arg, params, threadCounts, false, false, nullptr, nullptr };
+			std::string outFileName;
+			if ( matrix.outDir != nullptr )
+			{
+				outFileName = testRunFileName( matrix.outDir, run );
+				if ( fileExists( outFileName.c_str() ) )
+				{
+					printf( "skipping allocator '%s' (results are already in \'%s\')\n", run.arg, outFileName.c_str() );
+					continue;
+				}
+			}
+
+			if ( inProcess )
+				runTestSeriesInProcess( run );
+			else
+				runTestSeriesInChildProcess( run );
+
+			if ( !outFileName.empty() && run.succeeded && params.mat != MEM_ACCESS_TYPE::check )
+			{
+				// a partially written file must not make the point look done
+				std::string tmpFileName = outFileName + ".tmp";
+				AllocatorTestResults results = run.results();
+				if ( writeTestResultsJson( tmpFileName.c_str(), &results, 1 ) && rename( tmpFileName.c_str(), outFileName.c_str() ) != 0 )
+					printf( "failed to rename \'%s\' to \'%s\'\n", tmpFileName.c_str(), outFileName.c_str() );
+			}
+			runs.push_back( run );
+		}
+
+		if ( !inProcess && !runs.empty() )
+			printComparison( runs.data(), runs.size() );
+		for ( TestRun& run : runs )
+			if ( matrix.resultsFileName != nullptr )
+				allRuns.push_back( run );
+			else
+				releaseTestRun( run );
+	}
+
+	if ( matrix.resultsFileName != nullptr )
+	{
+		std::vector<AllocatorTestResults> results;
+		for ( const TestRun& run : allRuns )
+			if ( run.params.mat != MEM_ACCESS_TYPE::check )
+				results.push_back( run.results() );
+		if ( !results.empty() )
+			writeTestResultsJson( matrix.resultsFileName, results.data(), results.size() );
+	}
+
+	return 0;
+}
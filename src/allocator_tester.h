@@ -43,6 +43,7 @@
 #include <assert.h>
 #include <chrono>
 #include <random>
+#include <atomic>
 #include <limits.h>
 
 #ifndef __GNUC__
@@ -51,6 +52,7 @@
 #endif
 
 #include "test_common.h"
+#include "alloc_trace.h"
 #include "void_allocator.h" // used as an estimation of the cost of test itself
 
 
@@ -58,10 +60,21 @@ class PRNG
 {
 	uint64_t seedVal;
 public:
-	PRNG() { seedVal = 0; }
+	PRNG() { seedVal = seedForThread( 0, 0 ); }
 	PRNG( size_t seed_ ) { seedVal = seed_; }
 	void seed( size_t seed_ ) { seedVal = seed_; }
 
+	// 0 is a fixed point of xorshift, and nearby seeds give correlated sequences; thus a seed of each thread of a run
+	// is taken from a splitmix64 sequence started at the seed of the run, one element per thread
+	static uint64_t seedForThread( size_t rnd_seed, size_t threadID )
+	{
+		uint64_t x = rnd_seed + ( threadID + 1 ) * 0x9e3779b97f4a7c15ull;
+		x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+		x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+		x ^= x >> 31;
+		return x != 0 ? x : 0x9e3779b97f4a7c15ull;
+	}
+
 	/*FORCE_INLINE uint32_t rng32( uint32_t x )
 	{
 		// Algorithm "xor" from p. 4 of Marsaglia, "Xorshift RNGs"
@@ -169,9 +182,11 @@ struct Pareto_80_20_6_Data
 	uint32_t offsets[8];
 };
 
+// each range gets at least one item (of those left for the ranges after it), so itemCount must be at least pareto_min_item_count
 FORCE_INLINE
 void Pareto_80_20_6_Init( Pareto_80_20_6_Data& data, uint32_t itemCount )
 {
+	assert( itemCount >= pareto_min_item_count );
 	data.probabilityRanges[0] = (uint32_t)(UINT32_MAX * Pareto_80_20_6[0]);
 	data.probabilityRanges[5] = (uint32_t)(UINT32_MAX * (1. - Pareto_80_20_6[6]));
 	for ( size_t i=1; i<5; ++i )
@@ -179,7 +194,14 @@ void Pareto_80_20_6_Init( Pareto_80_20_6_Data& data, uint32_t itemCount )
 	data.offsets[0] = 0;
 	data.offsets[7] = itemCount;
 	for ( size_t i=0; i<6; ++i )
-		data.offsets[i+1] = data.offsets[i] + (uint32_t)(itemCount * Pareto_80_20_6[6-i]);
+	{
+		uint32_t rangeSize = (uint32_t)(itemCount * Pareto_80_20_6[6-i]);
+		if ( rangeSize == 0 )
+			rangeSize = 1;
+		if ( rangeSize > itemCount - data.offsets[i] - ( 6 - i ) )
+			rangeSize = itemCount - data.offsets[i] - ( 6 - i );
+		data.offsets[i+1] = data.offsets[i] + rangeSize;
+	}
 }
 
 FORCE_INLINE
@@ -244,8 +266,8 @@ void checkSegment( uint8_t* ptr, size_t sz, size_t reincarnation )
 	}
 }
 
-template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
-void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCount, size_t maxItems, size_t maxItemSizeExp, size_t threadID, size_t rnd_seed )
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat, bool collectOpLatencies = false>
+void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCount, size_t maxItems, size_t maxItemSizeExp, size_t threadID, size_t rnd_seed, size_t idleMs )
 {
 	if( maxItemSizeExp >= 32 )
 	{
@@ -254,11 +276,39 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 	}
 
 	static constexpr const char* memAccessTypeStr = mat == MEM_ACCESS_TYPE::none ? "none" : ( mat == MEM_ACCESS_TYPE::single ? "single" : ( mat == MEM_ACCESS_TYPE::full ? "full" : ( mat == MEM_ACCESS_TYPE::check ? "check" : "unknown" ) ) );
-	printf( "    running thread %zd with \'%s\' and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s,  [rnd_seed = %llu] ...\n", threadID, allocatorUnderTest.name(), maxItemSizeExp, maxItems, iterCount, memAccessTypeStr, rnd_seed );
+	printf( "    running thread %zd with \'%s\' and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s%s,  [rnd_seed = %zd, rng seed = 0x%llx] ...\n", threadID, allocatorUnderTest.name(), maxItemSizeExp, maxItems, iterCount, memAccessTypeStr, collectOpLatencies ? ", collecting per-operation latencies" : "", rnd_seed, (unsigned long long)PRNG::seedForThread( rnd_seed, threadID ) );
 	constexpr bool doMemAccess = mat != MEM_ACCESS_TYPE::none;
+
+	LatencyHistogram* allocLatency = allocatorUnderTest.getTestRes()->allocLatency;
+	LatencyHistogram* deallocLatency = allocatorUnderTest.getTestRes()->deallocLatency;
+	assert( !collectOpLatencies || ( allocLatency != nullptr && deallocLatency != nullptr ) );
+	auto allocateItem = [&]( size_t sz ) -> uint8_t* {
+		if constexpr ( collectOpLatencies )
+		{
+			uint64_t rdtscStart = __rdtsc();
+			void* ret = allocatorUnderTest.allocate( sz );
+			allocLatency->record( __rdtsc() - rdtscStart );
+			return reinterpret_cast<uint8_t*>( ret );
+		}
+		else
+			return reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( sz ) );
+	};
+	auto deallocateItem = [&]( void* ptr ) {
+		if constexpr ( collectOpLatencies )
+		{
+			uint64_t rdtscStart = __rdtsc();
+			allocatorUnderTest.deallocate( ptr );
+			deallocLatency->record( __rdtsc() - rdtscStart );
+		}
+		else
+			allocatorUnderTest.deallocate( ptr );
+	};
+
 	allocatorUnderTest.init();
 	allocatorUnderTest.getTestRes()->threadID = threadID; // just as received
+	allocatorUnderTest.getTestRes()->rngSeed = PRNG::seedForThread( rnd_seed, threadID );
 	allocatorUnderTest.getTestRes()->rdtscBegin = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_begin );
 
 	size_t start = GetMillisecondCount();
 
@@ -290,7 +340,7 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 	allocatedSz +=  maxItems * sizeof(TestBin);
 	memset( baseBuff, 0, maxItems * sizeof( TestBin ) );
 
-	PRNG rng;
+	PRNG rng( allocatorUnderTest.getTestRes()->rngSeed );
 
 	// setup (saturation)
 	for ( size_t i=0;i<maxItems/32; ++i )
@@ -302,7 +352,7 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 				size_t randNumSz = rng.rng64();
 				size_t sz = calcSizeWithStatsAdjustment( randNumSz, maxItemSizeExp );
 				baseBuff[i*32+j].sz = (uint32_t)sz;
-				baseBuff[i*32+j].ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( sz ) );
+				baseBuff[i*32+j].ptr = allocateItem( sz );
 				if constexpr ( doMemAccess )
 				{
 					if constexpr ( mat == MEM_ACCESS_TYPE::full )
@@ -324,6 +374,7 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 	}
 	allocatorUnderTest.doWhateverAfterSetupPhase();
 	allocatorUnderTest.getTestRes()->rdtscSetup = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_setup );
 	allocatorUnderTest.getTestRes()->allocatedAfterSetupSz = allocatedSz;
 
 	rss = getRss();
@@ -364,14 +415,14 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 #ifdef COLLECT_USER_MAX_ALLOCATED
 				allocatedSz -= baseBuff[idx].sz;
 #endif
-				allocatorUnderTest.deallocate( baseBuff[idx].ptr );
+				deallocateItem( baseBuff[idx].ptr );
 				baseBuff[idx].ptr = 0;
 			}
 			else
 			{
 				size_t sz = calcSizeWithStatsAdjustment( rng.rng64(), maxItemSizeExp );
 				baseBuff[idx].sz = (uint32_t)sz;
-				baseBuff[idx].ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( sz ) );
+				baseBuff[idx].ptr = allocateItem( sz );
 				if constexpr ( doMemAccess )
 				{
 					if constexpr ( mat == MEM_ACCESS_TYPE::full )
@@ -400,7 +451,10 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 	}
 	allocatorUnderTest.doWhateverAfterMainLoopPhase();
 	allocatorUnderTest.getTestRes()->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_main_loop );
 	allocatorUnderTest.getTestRes()->allocatedMax = allocatedSzMax;
+	allocatorUnderTest.getTestRes()->mainLoopOpCount = ( iterCount >> 5 ) << 5;
+	idleAfterMainLoop( allocatorUnderTest.getTestRes(), idleMs );
 
 	// exit
 	for ( size_t idx=0; idx<maxItems; ++idx )
@@ -428,7 +482,7 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 						}
 				}
 			}
-			allocatorUnderTest.deallocate( baseBuff[idx].ptr );
+			deallocateItem( baseBuff[idx].ptr );
 		}
 
 	if constexpr ( !allocatorUnderTest.isFake() )
@@ -437,7 +491,8 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 		allocatorUnderTest.deallocateSlots( baseBuff );
 	allocatorUnderTest.deinit();
 	allocatorUnderTest.getTestRes()->rdtscExit = __rdtsc();
-	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start;
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_exit );
+	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start - allocatorUnderTest.getTestRes()->idleDur;
 	allocatorUnderTest.doWhateverAfterCleanupPhase();
 
 	rss = getRss();
@@ -447,4 +502,876 @@ void randomPos_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCo
 	printf( "about to exit thread %zd (%zd operations performed) [ctr = %zd]...\n", threadID, iterCount, dummyCtr );
 };
 
+
+// producer/consumer test: items allocated by producers are handed off to consumers to be deallocated there
+
+struct HandoffItem
+{
+	uint8_t* ptr;
+	uint32_t sz;
+	uint32_t reincarnation;
+};
+
+constexpr size_t max_handoff_batch_size = 256;
+
+class SpscHandoffRing
+{
+	static constexpr size_t capacity = 1 << 10;
+	static_assert( capacity >= max_handoff_batch_size, "" );
+	HandoffItem items[capacity];
+	ALIGN(64) std::atomic<size_t> head; // written by consumer only
+	ALIGN(64) std::atomic<size_t> tail; // written by producer only
+
+public:
+	SpscHandoffRing() { head = 0; tail = 0; }
+
+	size_t push( const HandoffItem* batch, size_t cnt ) // returns a number of items actually pushed
+	{
+		size_t t = tail.load( std::memory_order_relaxed );
+		size_t room = capacity - ( t - head.load( std::memory_order_acquire ) );
+		if ( cnt > room )
+			cnt = room;
+		for ( size_t i=0; i<cnt; ++i )
+			items[(t + i) & (capacity - 1)] = batch[i];
+		tail.store( t + cnt, std::memory_order_release );
+		return cnt;
+	}
+
+	size_t pop( HandoffItem* batch, size_t maxCnt )
+	{
+		size_t h = head.load( std::memory_order_relaxed );
+		size_t cnt = tail.load( std::memory_order_acquire ) - h;
+		if ( cnt > maxCnt )
+			cnt = maxCnt;
+		for ( size_t i=0; i<cnt; ++i )
+			batch[i] = items[(h + i) & (capacity - 1)];
+		head.store( h + cnt, std::memory_order_release );
+		return cnt;
+	}
+};
+
+class MpmcHandoffRing
+{
+	// bounded queue by D.Vyukov, see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+	static constexpr size_t capacity = 1 << 14;
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		HandoffItem item;
+	};
+	Cell cells[capacity];
+	ALIGN(64) std::atomic<size_t> enqueuePos;
+	ALIGN(64) std::atomic<size_t> dequeuePos;
+
+public:
+	MpmcHandoffRing()
+	{
+		for ( size_t i=0; i<capacity; ++i )
+			cells[i].sequence.store( i, std::memory_order_relaxed );
+		enqueuePos = 0;
+		dequeuePos = 0;
+	}
+
+	bool push( const HandoffItem& item )
+	{
+		size_t pos = enqueuePos.load( std::memory_order_relaxed );
+		for (;;)
+		{
+			Cell& cell = cells[pos & (capacity - 1)];
+			intptr_t diff = (intptr_t)cell.sequence.load( std::memory_order_acquire ) - (intptr_t)pos;
+			if ( diff == 0 )
+			{
+				if ( enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+				{
+					cell.item = item;
+					cell.sequence.store( pos + 1, std::memory_order_release );
+					return true;
+				}
+			}
+			else if ( diff < 0 )
+				return false; // full
+			else
+				pos = enqueuePos.load( std::memory_order_relaxed );
+		}
+	}
+
+	bool pop( HandoffItem& item )
+	{
+		size_t pos = dequeuePos.load( std::memory_order_relaxed );
+		for (;;)
+		{
+			Cell& cell = cells[pos & (capacity - 1)];
+			intptr_t diff = (intptr_t)cell.sequence.load( std::memory_order_acquire ) - (intptr_t)(pos + 1);
+			if ( diff == 0 )
+			{
+				if ( dequeuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+				{
+					item = cell.item;
+					cell.sequence.store( pos + capacity, std::memory_order_release );
+					return true;
+				}
+			}
+			else if ( diff < 0 )
+				return false; // empty
+			else
+				pos = dequeuePos.load( std::memory_order_relaxed );
+		}
+	}
+
+	size_t push( const HandoffItem* batch, size_t cnt )
+	{
+		size_t i=0;
+		for ( ; i<cnt; ++i )
+			if ( !push( batch[i] ) )
+				break;
+		return i;
+	}
+
+	size_t pop( HandoffItem* batch, size_t maxCnt )
+	{
+		size_t i=0;
+		for ( ; i<maxCnt; ++i )
+			if ( !pop( batch[i] ) )
+				break;
+		return i;
+	}
+};
+
+struct HandoffContext
+{
+	size_t producerCount;
+	size_t consumerCount;
+	bool useSharedRing;
+	MpmcHandoffRing* sharedRing = nullptr;
+	SpscHandoffRing* rings = nullptr; // [producerCount * consumerCount], producer-major
+	std::atomic<size_t> producersDone;
+	std::atomic<size_t> consumersDone;
+
+	HandoffContext( size_t producerCount_, size_t consumerCount_, bool useSharedRing_ )
+	{
+		producerCount = producerCount_;
+		consumerCount = consumerCount_;
+		useSharedRing = useSharedRing_;
+		if ( useSharedRing )
+			sharedRing = new MpmcHandoffRing;
+		else
+			rings = new SpscHandoffRing[ producerCount * consumerCount ];
+		producersDone = 0;
+		consumersDone = 0;
+	}
+	~HandoffContext()
+	{
+		delete sharedRing;
+		delete [] rings;
+	}
+	HandoffContext(const HandoffContext&) = delete;
+	HandoffContext& operator=(const HandoffContext&) = delete;
+
+	void pushAll( size_t producerIdx, size_t consumerIdx, const HandoffItem* batch, size_t cnt )
+	{
+		size_t pushed = 0;
+		while ( pushed < cnt )
+		{
+			size_t done = useSharedRing ? sharedRing->push( batch + pushed, cnt - pushed ) : rings[ producerIdx * consumerCount + consumerIdx ].push( batch + pushed, cnt - pushed );
+			if ( done == 0 )
+				std::this_thread::yield(); // consumers are behind
+			pushed += done;
+		}
+	}
+
+	size_t pop( size_t producerIdx, size_t consumerIdx, HandoffItem* batch, size_t maxCnt )
+	{
+		return useSharedRing ? sharedRing->pop( batch, maxCnt ) : rings[ producerIdx * consumerCount + consumerIdx ].pop( batch, maxCnt );
+	}
+};
+
+template< MEM_ACCESS_TYPE mat>
+FORCE_INLINE void writeAllocatedItem( HandoffItem& item, uint32_t& reincarnation )
+{
+	if constexpr ( mat == MEM_ACCESS_TYPE::full )
+		memset( item.ptr, (uint8_t)item.sz, item.sz );
+	else if constexpr ( mat == MEM_ACCESS_TYPE::single )
+		item.ptr[item.sz/2] = (uint8_t)item.sz;
+	else if constexpr ( mat == MEM_ACCESS_TYPE::check )
+	{
+		item.reincarnation = reincarnation;
+		fillSegmentWithRandomData( item.ptr, item.sz, reincarnation++ );
+	}
+}
+
+template< MEM_ACCESS_TYPE mat>
+FORCE_INLINE void readItemBeforeDeallocation( const HandoffItem& item, size_t& dummyCtr )
+{
+	if constexpr ( mat == MEM_ACCESS_TYPE::full )
+	{
+		size_t i=0;
+		for ( ; i<item.sz/sizeof(size_t ); ++i )
+			dummyCtr += ( reinterpret_cast<size_t*>( item.ptr) )[i];
+		uint8_t* tail = item.ptr + i * sizeof(size_t );
+		for ( i=0; i<item.sz % sizeof(size_t); ++i )
+			dummyCtr += tail[i];
+	}
+	else if constexpr ( mat == MEM_ACCESS_TYPE::single )
+		dummyCtr += item.ptr[item.sz/2];
+	else if constexpr ( mat == MEM_ACCESS_TYPE::check )
+		checkSegment( item.ptr, item.sz, item.reincarnation );
+}
+
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
+void producerConsumer_Producer( AllocatorUnderTest& allocatorUnderTest, size_t iterCount, size_t maxItems, size_t maxItemSizeExp, size_t threadID, size_t rnd_seed, size_t handoffPercent, size_t batchSize, HandoffContext& ctx )
+{
+	if( maxItemSizeExp >= 32 )
+	{
+		printf( "allocation sizes greater than 2^31 are not yet supported; revise implementation, if desired\n" );
+		throw std::bad_exception();
+	}
+	if ( batchSize == 0 || batchSize > max_handoff_batch_size )
+	{
+		printf( "handoff batch size must be within [1, %zd]\n", max_handoff_batch_size );
+		throw std::bad_exception();
+	}
+
+	printf( "    running producer %zd with \'%s\' and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, handoff = %zd%% in batches of %zd via %s,  [rnd_seed = %zd, rng seed = 0x%llx] ...\n", threadID, allocatorUnderTest.name(), maxItemSizeExp, maxItems, iterCount, handoffPercent, batchSize, ctx.useSharedRing ? "shared MPMC ring" : "SPSC rings", rnd_seed, (unsigned long long)PRNG::seedForThread( rnd_seed, threadID ) );
+	allocatorUnderTest.init();
+	allocatorUnderTest.getTestRes()->threadID = threadID; // just as received
+	allocatorUnderTest.getTestRes()->rngSeed = PRNG::seedForThread( rnd_seed, threadID );
+	allocatorUnderTest.getTestRes()->rdtscBegin = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_begin );
+
+	size_t start = GetMillisecondCount();
+
+	size_t dummyCtr = 0;
+	size_t rssMax = 0;
+	size_t rss;
+	uint32_t reincarnation = 0;
+
+	// items which are not handed off are kept (and eventually deallocated) locally
+	HandoffItem* baseBuff = nullptr; 
+	if constexpr ( !allocatorUnderTest.isFake() )
+		baseBuff = reinterpret_cast<HandoffItem*>( allocatorUnderTest.allocate( maxItems * sizeof(HandoffItem) ) );
+	else
+		baseBuff = reinterpret_cast<HandoffItem*>( allocatorUnderTest.allocateSlots( maxItems * sizeof(HandoffItem) ) );
+	assert( baseBuff );
+	memset( baseBuff, 0, maxItems * sizeof( HandoffItem ) );
+
+	HandoffItem batch[max_handoff_batch_size];
+	size_t batchCnt = 0;
+	size_t batchesSent = 0;
+	size_t localDeallocs = 0;
+
+	PRNG rng( allocatorUnderTest.getTestRes()->rngSeed );
+
+	allocatorUnderTest.doWhateverAfterSetupPhase();
+	allocatorUnderTest.getTestRes()->rdtscSetup = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_setup );
+	allocatorUnderTest.getTestRes()->allocatedAfterSetupSz = maxItems * sizeof(HandoffItem);
+
+	// main loop
+	for ( size_t k=0 ; k<32; ++k )
+	{
+		for ( size_t j=0;j<iterCount>>5; ++j )
+		{
+			HandoffItem item;
+			item.sz = (uint32_t)calcSizeWithStatsAdjustment( rng.rng64(), maxItemSizeExp );
+			item.ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( item.sz ) );
+			writeAllocatedItem<mat>( item, reincarnation );
+			if ( rng.rng32() % 100 < handoffPercent )
+			{
+				batch[batchCnt++] = item;
+				if ( batchCnt == batchSize )
+				{
+					ctx.pushAll( threadID, ( threadID + batchesSent++ ) % ctx.consumerCount, batch, batchCnt );
+					batchCnt = 0;
+				}
+			}
+			else
+			{
+				size_t idx = rng.rng32() % maxItems;
+				if ( baseBuff[idx].ptr )
+				{
+					readItemBeforeDeallocation<mat>( baseBuff[idx], dummyCtr );
+					allocatorUnderTest.deallocate( baseBuff[idx].ptr );
+					++localDeallocs;
+				}
+				baseBuff[idx] = item;
+			}
+		}
+		rss = getRss();
+		if ( rssMax < rss ) rssMax = rss;
+	}
+	if ( batchCnt )
+		ctx.pushAll( threadID, ( threadID + batchesSent++ ) % ctx.consumerCount, batch, batchCnt );
+	ctx.producersDone.fetch_add( 1, std::memory_order_release );
+	allocatorUnderTest.doWhateverAfterMainLoopPhase();
+	allocatorUnderTest.getTestRes()->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_main_loop );
+	idleAfterMainLoop( allocatorUnderTest.getTestRes(), 0 );
+	allocatorUnderTest.getTestRes()->mainLoopOpCount = ( ( iterCount >> 5 ) << 5 ) + localDeallocs;
+
+	// exit
+	for ( size_t idx=0; idx<maxItems; ++idx )
+		if ( baseBuff[idx].ptr )
+		{
+			readItemBeforeDeallocation<mat>( baseBuff[idx], dummyCtr );
+			allocatorUnderTest.deallocate( baseBuff[idx].ptr );
+		}
+
+	if constexpr ( !allocatorUnderTest.isFake() )
+		allocatorUnderTest.deallocate( baseBuff );
+	else
+		allocatorUnderTest.deallocateSlots( baseBuff );
+
+	// items handed off may still be in use by consumers; memory of some allocators may not survive deinit()
+	while ( ctx.consumersDone.load( std::memory_order_acquire ) != ctx.consumerCount )
+		std::this_thread::yield();
+
+	allocatorUnderTest.deinit();
+	allocatorUnderTest.getTestRes()->rdtscExit = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_exit );
+	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start - allocatorUnderTest.getTestRes()->idleDur;
+	allocatorUnderTest.doWhateverAfterCleanupPhase();
+
+	rss = getRss();
+	if ( rssMax < rss ) rssMax = rss;
+	allocatorUnderTest.getTestRes()->rssMax = rssMax;
+	allocatorUnderTest.getTestRes()->allocatedMax = 0;
+		
+	printf( "about to exit producer %zd (%zd operations performed, %zd batches handed off) [ctr = %zd]...\n", threadID, iterCount, batchesSent, dummyCtr );
+}
+
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
+void producerConsumer_Consumer( AllocatorUnderTest& allocatorUnderTest, size_t consumerIdx, size_t threadID, size_t batchSize, HandoffContext& ctx )
+{
+	printf( "    running consumer %zd with \'%s\' ...\n", threadID, allocatorUnderTest.name() );
+	allocatorUnderTest.init();
+	allocatorUnderTest.getTestRes()->threadID = threadID; // just as received
+	allocatorUnderTest.getTestRes()->rdtscBegin = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_begin );
+	allocatorUnderTest.getTestRes()->rdtscSetup = allocatorUnderTest.getTestRes()->rdtscBegin;
+	allocatorUnderTest.getTestRes()->perfAt[test_point_setup] = allocatorUnderTest.getTestRes()->perfAt[test_point_begin];
+	allocatorUnderTest.getTestRes()->allocatedAfterSetupSz = 0;
+
+	size_t start = GetMillisecondCount();
+
+	size_t dummyCtr = 0;
+	size_t rssMax = 0;
+	size_t rss;
+	size_t itemsReceived = 0;
+	size_t producerIdx = 0;
+
+	HandoffItem batch[max_handoff_batch_size];
+
+	for (;;)
+	{
+		// once all producers are done, a full pass over rings without anything received means we are done as well
+		bool lastPass = ctx.producersDone.load( std::memory_order_acquire ) == ctx.producerCount;
+		size_t receivedInPass = 0;
+		for ( size_t i=0; i<ctx.producerCount; ++i )
+		{
+			size_t cnt = ctx.pop( producerIdx, consumerIdx, batch, batchSize );
+			producerIdx = producerIdx + 1 == ctx.producerCount ? 0 : producerIdx + 1;
+			for ( size_t j=0; j<cnt; ++j )
+			{
+				readItemBeforeDeallocation<mat>( batch[j], dummyCtr );
+				allocatorUnderTest.deallocate( batch[j].ptr );
+			}
+			receivedInPass += cnt;
+		}
+		itemsReceived += receivedInPass;
+		if ( receivedInPass == 0 )
+		{
+			if ( lastPass )
+				break;
+			std::this_thread::yield();
+		}
+		else if ( ( itemsReceived & 0xFFFF ) < receivedInPass )
+		{
+			rss = getRss();
+			if ( rssMax < rss ) rssMax = rss;
+		}
+	}
+	allocatorUnderTest.doWhateverAfterMainLoopPhase();
+	allocatorUnderTest.getTestRes()->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_main_loop );
+	idleAfterMainLoop( allocatorUnderTest.getTestRes(), 0 );
+	allocatorUnderTest.getTestRes()->mainLoopOpCount = itemsReceived;
+
+	ctx.consumersDone.fetch_add( 1, std::memory_order_release );
+
+	allocatorUnderTest.deinit();
+	allocatorUnderTest.getTestRes()->rdtscExit = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_exit );
+	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start - allocatorUnderTest.getTestRes()->idleDur;
+	allocatorUnderTest.doWhateverAfterCleanupPhase();
+
+	rss = getRss();
+	if ( rssMax < rss ) rssMax = rss;
+	allocatorUnderTest.getTestRes()->rssMax = rssMax;
+	allocatorUnderTest.getTestRes()->allocatedMax = 0;
+
+	printf( "about to exit consumer %zd (%zd items deallocated) [ctr = %zd]...\n", threadID, itemsReceived, dummyCtr );
+}
+
+
+// fast path microbenchmark: in a small working set each item is deallocated right before a new one takes its slot,
+// so that, once warmed up, an allocator has a free item of about any size at hand and (almost) never leaves its fast path;
+// sizes and slots are generated before the main loop, which is thus nothing but allocate()/deallocate() calls
+
+constexpr size_t fast_path_size_count = 1 << 12;
+
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
+void fastPath_SmallSizes( AllocatorUnderTest& allocatorUnderTest, size_t iterCount, size_t maxItems, size_t maxItemSizeExp, size_t threadID, size_t rnd_seed )
+{
+	static constexpr const char* memAccessTypeStr = mat == MEM_ACCESS_TYPE::none ? "none" : ( mat == MEM_ACCESS_TYPE::single ? "single" : ( mat == MEM_ACCESS_TYPE::full ? "full" : ( mat == MEM_ACCESS_TYPE::check ? "check" : "unknown" ) ) );
+	// a power of 2 not above maxItems (and the number of pregenerated sizes)
+	size_t slotCount = 1;
+	while ( slotCount * 2 <= maxItems && slotCount * 2 <= fast_path_size_count )
+		slotCount *= 2;
+	printf( "    running thread %zd with \'%s\' (fast path) and maxItemSizeExp = %zd, slots = %zd, iterCount = %zd, allocated memory access mode: %s,  [rnd_seed = %zd, rng seed = 0x%llx] ...\n", threadID, allocatorUnderTest.name(), maxItemSizeExp, slotCount, iterCount, memAccessTypeStr, rnd_seed, (unsigned long long)PRNG::seedForThread( rnd_seed, threadID ) );
+	constexpr MEM_ACCESS_TYPE actualMat = allocatorUnderTest.isFake() ? MEM_ACCESS_TYPE::none : mat;
+
+	allocatorUnderTest.init();
+	allocatorUnderTest.getTestRes()->threadID = threadID; // just as received
+	allocatorUnderTest.getTestRes()->rngSeed = PRNG::seedForThread( rnd_seed, threadID );
+	allocatorUnderTest.getTestRes()->rdtscBegin = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_begin );
+
+	size_t start = GetMillisecondCount();
+
+	size_t dummyCtr = 0;
+	size_t rssMax = 0;
+	size_t rss;
+	uint32_t reincarnation = 0;
+
+	// test data itself is not allocated by the allocator under test, to keep its fast path as it is
+	HandoffItem* slots = new HandoffItem[ slotCount ];
+	uint32_t* sizes = new uint32_t[ fast_path_size_count ];
+	PRNG rng( allocatorUnderTest.getTestRes()->rngSeed );
+	for ( size_t i=0; i<fast_path_size_count; ++i )
+		sizes[i] = (uint32_t)calcSizeWithStatsAdjustment( rng.rng64(), maxItemSizeExp );
+
+	// setup (also warming up buckets of sizes in use)
+	size_t allocatedSz = 0;
+	for ( size_t i=0; i<slotCount; ++i )
+	{
+		slots[i].sz = sizes[i];
+		slots[i].ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( slots[i].sz ) );
+		writeAllocatedItem<actualMat>( slots[i], reincarnation );
+		allocatedSz += slots[i].sz;
+	}
+	allocatorUnderTest.doWhateverAfterSetupPhase();
+	allocatorUnderTest.getTestRes()->rdtscSetup = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_setup );
+	allocatorUnderTest.getTestRes()->allocatedAfterSetupSz = allocatedSz;
+
+	// main loop
+	for ( size_t i=0; i<iterCount; ++i )
+	{
+		HandoffItem& slot = slots[ i & ( slotCount - 1 ) ];
+		readItemBeforeDeallocation<actualMat>( slot, dummyCtr );
+		allocatorUnderTest.deallocate( slot.ptr );
+		slot.sz = sizes[ ( i + i / fast_path_size_count ) & ( fast_path_size_count - 1 ) ]; // sizes are shifted on each round
+		slot.ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( slot.sz ) );
+		writeAllocatedItem<actualMat>( slot, reincarnation );
+	}
+	allocatorUnderTest.doWhateverAfterMainLoopPhase();
+	allocatorUnderTest.getTestRes()->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_main_loop );
+	idleAfterMainLoop( allocatorUnderTest.getTestRes(), 0 );
+	allocatorUnderTest.getTestRes()->allocatedMax = 0;
+	allocatorUnderTest.getTestRes()->mainLoopOpCount = 2 * iterCount;
+	rss = getRss();
+	if ( rssMax < rss ) rssMax = rss;
+
+	// exit
+	for ( size_t i=0; i<slotCount; ++i )
+	{
+		readItemBeforeDeallocation<actualMat>( slots[i], dummyCtr );
+		allocatorUnderTest.deallocate( slots[i].ptr );
+	}
+	delete [] slots;
+	delete [] sizes;
+
+	allocatorUnderTest.deinit();
+	allocatorUnderTest.getTestRes()->rdtscExit = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_exit );
+	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start - allocatorUnderTest.getTestRes()->idleDur;
+	allocatorUnderTest.doWhateverAfterCleanupPhase();
+
+	rss = getRss();
+	if ( rssMax < rss ) rssMax = rss;
+	allocatorUnderTest.getTestRes()->rssMax = rssMax;
+
+	printf( "about to exit thread %zd (%zd operations performed) [ctr = %zd]...\n", threadID, 2 * iterCount, dummyCtr );
+}
+
+
+// load shift: threads run their main loops one after another, each freeing all of its items at the end of its turn
+// and then staying idle with its heap until all turns are over; memory freed by threads that are done is expected
+// to serve the following ones rather than stay with their heaps
+
+struct LoadShiftContext
+{
+	size_t threadCount;
+	std::atomic<size_t> turn; // the thread whose turn it is; threadCount once all turns are over
+
+	LoadShiftContext( size_t threadCount_ )
+	{
+		threadCount = threadCount_;
+		turn = 0;
+	}
+	LoadShiftContext(const LoadShiftContext&) = delete;
+	LoadShiftContext& operator=(const LoadShiftContext&) = delete;
+
+	void waitFor( size_t value )
+	{
+		while ( turn.load( std::memory_order_acquire ) != value )
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+};
+
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
+void loadShift_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCount, size_t maxItems, size_t maxItemSizeExp, size_t threadID, size_t rnd_seed, LoadShiftContext& ctx )
+{
+	static constexpr const char* memAccessTypeStr = mat == MEM_ACCESS_TYPE::none ? "none" : ( mat == MEM_ACCESS_TYPE::single ? "single" : ( mat == MEM_ACCESS_TYPE::full ? "full" : ( mat == MEM_ACCESS_TYPE::check ? "check" : "unknown" ) ) );
+	printf( "    running thread %zd with \'%s\' (load shift, turn %zd of %zd) and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s,  [rnd_seed = %zd, rng seed = 0x%llx] ...\n", threadID, allocatorUnderTest.name(), threadID + 1, ctx.threadCount, maxItemSizeExp, maxItems, iterCount, memAccessTypeStr, rnd_seed, (unsigned long long)PRNG::seedForThread( rnd_seed, threadID ) );
+	constexpr MEM_ACCESS_TYPE actualMat = allocatorUnderTest.isFake() ? MEM_ACCESS_TYPE::none : mat;
+
+	allocatorUnderTest.init();
+	allocatorUnderTest.getTestRes()->threadID = threadID; // just as received
+	allocatorUnderTest.getTestRes()->rngSeed = PRNG::seedForThread( rnd_seed, threadID );
+	ctx.waitFor( threadID );
+	allocatorUnderTest.getTestRes()->rdtscBegin = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_begin );
+
+	size_t start = GetMillisecondCount();
+
+	size_t dummyCtr = 0;
+	size_t rssMax = 0;
+	size_t rss;
+	uint32_t reincarnation = 0;
+
+	// test data itself is not allocated by the allocator under test, for it not to be left with idle heaps
+	HandoffItem* slots = new HandoffItem[ maxItems ];
+	PRNG rng( allocatorUnderTest.getTestRes()->rngSeed );
+
+	// sizes are uniform rather than stats-adjusted: memory that heaps keep for reuse is mostly in large chunks
+	size_t sizeMask = ( ((size_t)1) << maxItemSizeExp ) - 1;
+
+	// setup
+	size_t allocatedSz = 0;
+	for ( size_t i=0; i<maxItems; ++i )
+	{
+		slots[i].sz = (uint32_t)( rng.rng64() & sizeMask ) + 1;
+		slots[i].ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( slots[i].sz ) );
+		writeAllocatedItem<actualMat>( slots[i], reincarnation );
+		allocatedSz += slots[i].sz;
+	}
+	allocatorUnderTest.doWhateverAfterSetupPhase();
+	allocatorUnderTest.getTestRes()->rdtscSetup = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_setup );
+	allocatorUnderTest.getTestRes()->allocatedAfterSetupSz = allocatedSz;
+
+	// main loop
+	for ( size_t k=0 ; k<32; ++k )
+	{
+		for ( size_t j=0;j<iterCount>>5; ++j )
+		{
+			HandoffItem& slot = slots[ rng.rng32() % maxItems ];
+			readItemBeforeDeallocation<actualMat>( slot, dummyCtr );
+			allocatorUnderTest.deallocate( slot.ptr );
+			slot.sz = (uint32_t)( rng.rng64() & sizeMask ) + 1;
+			slot.ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( slot.sz ) );
+			writeAllocatedItem<actualMat>( slot, reincarnation );
+		}
+		rss = getRss();
+		if ( rssMax < rss ) rssMax = rss;
+	}
+
+	// end of the turn
+	for ( size_t i=0; i<maxItems; ++i )
+	{
+		readItemBeforeDeallocation<actualMat>( slots[i], dummyCtr );
+		allocatorUnderTest.deallocate( slots[i].ptr );
+	}
+	delete [] slots;
+	allocatorUnderTest.doWhateverAfterMainLoopPhase();
+	allocatorUnderTest.getTestRes()->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_main_loop );
+	allocatorUnderTest.getTestRes()->allocatedMax = allocatedSz;
+	allocatorUnderTest.getTestRes()->mainLoopOpCount = 2 * ( ( iterCount >> 5 ) << 5 );
+	allocatorUnderTest.getTestRes()->rssAfterTurn = getRss();
+	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start;
+
+	// idle with the heap kept until all turns are over (not an idle phase with RSS sampled, as of idleAfterMainLoop())
+	ctx.turn.store( threadID + 1, std::memory_order_release );
+	ctx.waitFor( ctx.threadCount );
+	allocatorUnderTest.getTestRes()->rdtscIdle = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_idle );
+
+	// exit
+	allocatorUnderTest.deinit();
+	allocatorUnderTest.getTestRes()->rdtscExit = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_exit );
+	allocatorUnderTest.doWhateverAfterCleanupPhase();
+
+	allocatorUnderTest.getTestRes()->rssMax = rssMax;
+
+	printf( "about to exit thread %zd (%zd operations performed) [ctr = %zd]...\n", threadID, 2 * iterCount, dummyCtr );
+}
+
+
+// thread churn: each thread starts short-lived threads one after another, iterCount of them, as a thread pool resized
+// on demand does; each of them allocates maxItems items, replaces maxItems items at random and deallocates all of them
+// before it exits. Performance counters of short-lived threads are added up to the main loop of the thread.
+
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
+void threadChurn_RandomSize( AllocatorUnderTest& allocatorUnderTest, size_t iterCount, size_t maxItems, size_t maxItemSizeExp, size_t threadID, size_t rnd_seed )
+{
+	static constexpr const char* memAccessTypeStr = mat == MEM_ACCESS_TYPE::none ? "none" : ( mat == MEM_ACCESS_TYPE::single ? "single" : ( mat == MEM_ACCESS_TYPE::full ? "full" : ( mat == MEM_ACCESS_TYPE::check ? "check" : "unknown" ) ) );
+	printf( "    running thread %zd with \'%s\' (thread churn) and maxItemSizeExp = %zd, maxItems = %zd, iterCount = %zd, allocated memory access mode: %s,  [rnd_seed = %zd, rng seed = 0x%llx] ...\n", threadID, allocatorUnderTest.name(), maxItemSizeExp, maxItems, iterCount, memAccessTypeStr, rnd_seed, (unsigned long long)PRNG::seedForThread( rnd_seed, threadID ) );
+	constexpr MEM_ACCESS_TYPE actualMat = allocatorUnderTest.isFake() ? MEM_ACCESS_TYPE::none : mat;
+
+	ThreadTestRes* testRes = allocatorUnderTest.getTestRes();
+	testRes->threadID = threadID; // just as received
+	testRes->rngSeed = PRNG::seedForThread( rnd_seed, threadID );
+	testRes->rdtscBegin = __rdtsc();
+	capturePerfCounters( testRes, test_point_begin );
+
+	size_t start = GetMillisecondCount();
+
+	size_t dummyCtr = 0;
+	size_t rssMax = 0;
+	size_t rss;
+	uint32_t reincarnation = 0;
+	size_t allocatedSz = 0;
+	uint64_t churnPerf[perf_counter_count] = {};
+	uint32_t churnPerfAvailable = 0;
+
+	// test data itself is not allocated by the allocator under test, for it not to be a part of heaps to be churned
+	HandoffItem* slots = new HandoffItem[ maxItems ];
+	PRNG rng( testRes->rngSeed );
+
+	testRes->rdtscSetup = __rdtsc();
+	capturePerfCounters( testRes, test_point_setup );
+
+	// main loop; RSS is sampled about 32 times over it (after each thread, if fewer are started)
+	size_t rssSampleStep = iterCount >= 32 ? iterCount >> 5 : 1;
+	for ( size_t j=0; j<iterCount; ++j )
+	{
+		std::thread t( [&]() {
+			ThreadTestRes churnRes = {};
+			capturePerfCounters( &churnRes, test_point_begin );
+			allocatorUnderTest.init();
+			allocatedSz = 0;
+			for ( size_t i=0; i<maxItems; ++i )
+			{
+				slots[i].sz = (uint32_t)calcSizeWithStatsAdjustment( rng.rng64(), maxItemSizeExp );
+				slots[i].ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( slots[i].sz ) );
+				writeAllocatedItem<actualMat>( slots[i], reincarnation );
+				allocatedSz += slots[i].sz;
+			}
+			for ( size_t i=0; i<maxItems; ++i )
+			{
+				HandoffItem& slot = slots[ rng.rng32() % maxItems ];
+				readItemBeforeDeallocation<actualMat>( slot, dummyCtr );
+				allocatorUnderTest.deallocate( slot.ptr );
+				slot.sz = (uint32_t)calcSizeWithStatsAdjustment( rng.rng64(), maxItemSizeExp );
+				slot.ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( slot.sz ) );
+				writeAllocatedItem<actualMat>( slot, reincarnation );
+			}
+			for ( size_t i=0; i<maxItems; ++i )
+			{
+				readItemBeforeDeallocation<actualMat>( slots[i], dummyCtr );
+				allocatorUnderTest.deallocate( slots[i].ptr );
+			}
+			allocatorUnderTest.deinit();
+			capturePerfCounters( &churnRes, test_point_exit );
+			for ( size_t c=0; c<perf_counter_count; ++c )
+				churnPerf[c] += churnRes.perfAt[test_point_exit].values[c] - churnRes.perfAt[test_point_begin].values[c];
+			churnPerfAvailable = churnRes.perfCountersAvailable;
+		} );
+		t.join();
+		if ( ( j + 1 ) % rssSampleStep == 0 || j + 1 == iterCount )
+		{
+			rss = getRss();
+			if ( rssMax < rss ) rssMax = rss;
+		}
+	}
+	delete [] slots;
+
+	testRes->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( testRes, test_point_main_loop );
+	testRes->allocatedAfterSetupSz = allocatedSz;
+	testRes->allocatedMax = allocatedSz;
+	testRes->mainLoopOpCount = 4 * maxItems * iterCount;
+	testRes->innerDur = GetMillisecondCount() - start;
+
+	idleAfterMainLoop( testRes, 0 );
+	testRes->rdtscExit = __rdtsc();
+	capturePerfCounters( testRes, test_point_exit );
+	allocatorUnderTest.doWhateverAfterCleanupPhase();
+
+	// the thread itself only waits for those it starts
+	testRes->perfCountersAvailable &= churnPerfAvailable;
+	for ( size_t point=test_point_main_loop; point<test_point_count; ++point )
+		for ( size_t c=0; c<perf_counter_count; ++c )
+			testRes->perfAt[point].values[c] += churnPerf[c];
+
+	testRes->rssMax = rssMax;
+
+	printf( "about to exit thread %zd (%zd threads started) [ctr = %zd]...\n", threadID, iterCount, dummyCtr );
+}
+
+// trace replay: thread N replays records of thread N of a trace
+// deallocations of objects allocated by other threads wait until respective allocations are replayed,
+// thus keeping the order of operations over each object (and the whole replay) deterministic
+
+struct ReplayObject
+{
+	std::atomic<uint8_t*> ptr;
+	uint32_t sz;
+	uint32_t reincarnation;
+};
+
+struct TraceReplayContext
+{
+	const AllocTrace* trace;
+	ReplayObject* objects; // [trace->objectCount()]
+	std::atomic<size_t> threadsDone;
+	std::atomic<size_t> threadsCleanedUp;
+	std::atomic<int64_t> allocatedSz; // by all threads, as objects may be deallocated by other threads than their own
+
+	TraceReplayContext( const AllocTrace* trace_ )
+	{
+		trace = trace_;
+		objects = new ReplayObject[ trace->objectCount() ](); // zeroed
+		threadsDone = 0;
+		threadsCleanedUp = 0;
+		allocatedSz = 0;
+	}
+	~TraceReplayContext() { delete [] objects; }
+	TraceReplayContext(const TraceReplayContext&) = delete;
+	TraceReplayContext& operator=(const TraceReplayContext&) = delete;
+};
+
+template< class AllocatorUnderTest, MEM_ACCESS_TYPE mat>
+void traceReplay( AllocatorUnderTest& allocatorUnderTest, size_t threadID, TraceReplayContext& ctx )
+{
+	const AllocTrace& trace = *(ctx.trace);
+	static constexpr const char* memAccessTypeStr = mat == MEM_ACCESS_TYPE::none ? "none" : ( mat == MEM_ACCESS_TYPE::single ? "single" : ( mat == MEM_ACCESS_TYPE::full ? "full" : ( mat == MEM_ACCESS_TYPE::check ? "check" : "unknown" ) ) );
+	printf( "    running thread %zd with \'%s\' replaying %zd records, allocated memory access mode: %s ...\n", threadID, allocatorUnderTest.name(), trace.threadRecordCount( threadID ), memAccessTypeStr );
+	// sizes in a trace are not limited; for fake allocators memory is not accessed at all
+	constexpr MEM_ACCESS_TYPE actualMat = allocatorUnderTest.isFake() ? MEM_ACCESS_TYPE::none : mat;
+	allocatorUnderTest.init();
+	allocatorUnderTest.getTestRes()->threadID = threadID; // just as received
+	allocatorUnderTest.getTestRes()->rdtscBegin = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_begin );
+
+	size_t start = GetMillisecondCount();
+
+	size_t dummyCtr = 0;
+	size_t rssMax = 0;
+	size_t rss;
+	int64_t allocatedSzMax = 0; // of ctx.allocatedSz, as of allocations of this thread
+	size_t recordsDone = 0;
+
+	allocatorUnderTest.doWhateverAfterSetupPhase();
+	allocatorUnderTest.getTestRes()->rdtscSetup = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_setup );
+	allocatorUnderTest.getTestRes()->allocatedAfterSetupSz = 0;
+
+	// main loop
+	for ( size_t runIdx=0; runIdx<trace.runCount( threadID ); ++runIdx )
+	{
+		const AllocTrace::Run& run = trace.getRun( threadID, runIdx );
+		for ( size_t i=0; i<run.recordCount; ++i )
+		{
+			const AllocTraceRecord& rec = run.records[i];
+			assert( rec.objectID < trace.objectCount() ); // validated by AllocTrace::open()
+			ReplayObject& obj = ctx.objects[ rec.objectID ];
+			if ( rec.op == ALLOC_TRACE_OP::alloc_trace_allocate )
+			{
+				HandoffItem item = {};
+				item.sz = rec.size;
+				item.ptr = reinterpret_cast<uint8_t*>( allocatorUnderTest.allocate( rec.size ) );
+				uint32_t reincarnation = rec.objectID;
+				writeAllocatedItem<actualMat>( item, reincarnation );
+				obj.sz = item.sz;
+				obj.reincarnation = item.reincarnation;
+#ifdef COLLECT_USER_MAX_ALLOCATED
+				// before ptr is published, so that it is not subtracted by a deallocating thread before being added
+				int64_t allocatedSz = ctx.allocatedSz.fetch_add( rec.size, std::memory_order_relaxed ) + rec.size;
+				if ( allocatedSzMax < allocatedSz )
+					allocatedSzMax = allocatedSz;
+#endif
+				obj.ptr.store( item.ptr, std::memory_order_release );
+			}
+			else
+			{
+				HandoffItem item;
+				item.ptr = obj.ptr.load( std::memory_order_acquire );
+				while ( item.ptr == nullptr ) // allocated by another thread which is behind
+				{
+					std::this_thread::yield();
+					item.ptr = obj.ptr.load( std::memory_order_acquire );
+				}
+				item.sz = obj.sz;
+				item.reincarnation = obj.reincarnation;
+				readItemBeforeDeallocation<actualMat>( item, dummyCtr );
+				allocatorUnderTest.deallocate( item.ptr );
+				obj.ptr.store( nullptr, std::memory_order_relaxed );
+#ifdef COLLECT_USER_MAX_ALLOCATED
+				ctx.allocatedSz.fetch_sub( item.sz, std::memory_order_relaxed );
+#endif
+			}
+		}
+		recordsDone += run.recordCount;
+		if ( ( recordsDone & 0xFFFF ) < run.recordCount )
+		{
+			rss = getRss();
+			if ( rssMax < rss ) rssMax = rss;
+		}
+	}
+	ctx.threadsDone.fetch_add( 1, std::memory_order_release );
+	allocatorUnderTest.doWhateverAfterMainLoopPhase();
+	allocatorUnderTest.getTestRes()->rdtscMainLoop = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_main_loop );
+	idleAfterMainLoop( allocatorUnderTest.getTestRes(), 0 );
+	allocatorUnderTest.getTestRes()->allocatedMax = (size_t)allocatedSzMax; // the largest of all threads is the peak of the process
+	allocatorUnderTest.getTestRes()->mainLoopOpCount = recordsDone;
+	rss = getRss();
+	if ( rssMax < rss ) rssMax = rss;
+
+	// exit: objects never deallocated in a trace are deallocated here, each thread taking its share
+	while ( ctx.threadsDone.load( std::memory_order_acquire ) != trace.threadCount() )
+		std::this_thread::yield();
+	for ( size_t idx=threadID; idx<trace.objectCount(); idx += trace.threadCount() )
+	{
+		ReplayObject& obj = ctx.objects[ idx ];
+		uint8_t* ptr = obj.ptr.load( std::memory_order_relaxed );
+		if ( ptr )
+		{
+			allocatorUnderTest.deallocate( ptr );
+			obj.ptr.store( nullptr, std::memory_order_relaxed );
+		}
+	}
+	// memory of some allocators may not survive deinit() while other threads still deallocate objects allocated here
+	ctx.threadsCleanedUp.fetch_add( 1, std::memory_order_release );
+	while ( ctx.threadsCleanedUp.load( std::memory_order_acquire ) != trace.threadCount() )
+		std::this_thread::yield();
+
+	allocatorUnderTest.deinit();
+	allocatorUnderTest.getTestRes()->rdtscExit = __rdtsc();
+	capturePerfCounters( allocatorUnderTest.getTestRes(), test_point_exit );
+	allocatorUnderTest.getTestRes()->innerDur = GetMillisecondCount() - start - allocatorUnderTest.getTestRes()->idleDur;
+	allocatorUnderTest.doWhateverAfterCleanupPhase();
+
+	rss = getRss();
+	if ( rssMax < rss ) rssMax = rss;
+	allocatorUnderTest.getTestRes()->rssMax = rssMax;
+
+	printf( "about to exit thread %zd (%zd records replayed) [ctr = %zd]...\n", threadID, recordsDone, dummyCtr );
+}
+
 #endif // ALLOCATOR_TESTER_H
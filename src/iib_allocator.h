@@ -65,11 +65,124 @@ public:
 	// next calls are to get additional stats of the allocator, etc, if desired
 	void doWhateverAfterSetupPhase() {}
 	void doWhateverAfterMainLoopPhase() {}
-	void doWhateverAfterCleanupPhase() {}
+	void doWhateverAfterCleanupPhase() { g_AllocManager.releasePooledBlocks(); } // not to be counted by tests that follow
 
 	ThreadTestRes* getTestRes() { return testRes; }
 };
 
+// the same with reservations backed with huge pages; the setting is process-wide and is left set
+class IibmallocHugePagesAllocatorForTest : public IibmallocAllocatorForTest
+{
+public:
+	IibmallocHugePagesAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocAllocatorForTest( testRes_ ) {}
+
+	static constexpr const char* name() { return "iibmalloc allocator (huge pages)"; }
+
+	void init()
+	{
+		g_UseHugePages.store( true, std::memory_order_relaxed );
+		IibmallocAllocatorForTest::init();
+	}
+};
+
+// a thread-local heap of a given configuration (see SerializableAllocator) in place of g_AllocManager,
+// so that configurations can be compared side by side within a single tester binary
+template<class HeapT>
+class IibmallocConfigAllocatorForTest
+{
+	ThreadTestRes* testRes;
+
+	static HeapT& heap()
+	{
+		static thread_local HeapT h;
+		return h;
+	}
+
+public:
+	IibmallocConfigAllocatorForTest( ThreadTestRes* testRes_ ) { testRes = testRes_; }
+	static constexpr bool isFake() { return false; }
+
+	void init()
+	{
+		heap().initialize();
+		heap().enable();
+	}
+	void* allocate( size_t sz ) { return heap().allocate( sz ); }
+	void deallocate( void* ptr ) { heap().deallocate( ptr ); }
+	void deinit()
+	{
+		heap().deinitialize();
+		heap().disable();
+	}
+
+	// next calls are to get additional stats of the allocator, etc, if desired
+	void doWhateverAfterSetupPhase() {}
+	void doWhateverAfterMainLoopPhase() {}
+	void doWhateverAfterCleanupPhase() { heap().releasePooledBlocks(); }
+
+	ThreadTestRes* getTestRes() { return testRes; }
+};
+
+class IibmallocExpAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<ExpBucketSizes, PAGE_SIZE * 2, 4, 23>>
+{
+public:
+	IibmallocExpAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (exp bucket sizes)"; }
+};
+
+class IibmallocQuarterExpAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<QuarterExpBucketSizes, PAGE_SIZE * 2, 6, 23>>
+{
+public:
+	IibmallocQuarterExpAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (quarter-exp bucket sizes)"; }
+};
+
+// the same bucket size schemes with a lookup table for sizeToIndex() (see TableBucketSizes)
+class IibmallocTableAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<TableBucketSizes<HalfExpBucketSizes, PAGE_SIZE * 2>, PAGE_SIZE * 2, 6, 23>>
+{
+public:
+	IibmallocTableAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (half-exp bucket sizes, lookup table)"; }
+};
+
+class IibmallocExpTableAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<TableBucketSizes<ExpBucketSizes, PAGE_SIZE * 2>, PAGE_SIZE * 2, 4, 23>>
+{
+public:
+	IibmallocExpTableAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (exp bucket sizes, lookup table)"; }
+};
+
+class IibmallocQuarterExpTableAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<TableBucketSizes<QuarterExpBucketSizes, PAGE_SIZE * 2>, PAGE_SIZE * 2, 6, 23>>
+{
+public:
+	IibmallocQuarterExpTableAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (quarter-exp bucket sizes, lookup table)"; }
+};
+
+// spans are formatted lazily (see lazy_formatting of SerializableAllocator)
+class IibmallocLazyAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<HalfExpBucketSizes, PAGE_SIZE * 2, 6, 23, true>>
+{
+public:
+	IibmallocLazyAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (lazy span formatting)"; }
+};
+
+// buckets up to 16K in 16M reservations
+class IibmallocLargeBucketsAllocatorForTest : public IibmallocConfigAllocatorForTest<SerializableAllocator<HalfExpBucketSizes, PAGE_SIZE * 4, 6, 24>>
+{
+public:
+	IibmallocLargeBucketsAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (16K buckets, 16M reservations)"; }
+};
+
+// heaps of exited threads are parked and adopted by threads started later (see AdoptingThreadHeap)
+class IibmallocAdoptingAllocatorForTest : public IibmallocConfigAllocatorForTest<AdoptingThreadHeap<SerializableAllocatorBase>>
+{
+public:
+	IibmallocAdoptingAllocatorForTest( ThreadTestRes* testRes_ ) : IibmallocConfigAllocatorForTest( testRes_ ) {}
+	static constexpr const char* name() { return "iibmalloc allocator (heaps of exited threads adopted)"; }
+};
+
 
 
 
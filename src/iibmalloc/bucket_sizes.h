@@ -0,0 +1,253 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * iibmalloc allocator
+ * Bucket sizes:
+ *     - schemes mapping a requested size to a bucket index and back,
+ *       to be used as a policy parameter of SerializableAllocator
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+ 
+#ifndef BUCKET_SIZES_H
+#define BUCKET_SIZES_H
+
+#include "iibmalloc_common.h"
+
+
+// index of the highest set bit; x != 0 (only sizes of buckets are passed here, so 32 bits are enough on 32-bit platforms)
+#if defined(_MSC_VER)
+#if defined(_M_IX86)
+FORCE_INLINE uint8_t highestBitIdx( size_t x )
+{
+	unsigned long ix;
+	_BitScanReverse( &ix, (uint32_t)x );
+	return static_cast<uint8_t>(ix);
+}
+#elif defined(_M_X64)
+FORCE_INLINE uint8_t highestBitIdx( size_t x )
+{
+	unsigned long ix;
+	_BitScanReverse64( &ix, x );
+	return static_cast<uint8_t>(ix);
+}
+#else
+#error Unknown 32/64 bits architecture
+#endif
+
+#elif defined(__GNUC__)
+#if defined(__i386__)
+FORCE_INLINE uint8_t highestBitIdx( size_t x )
+{
+	return static_cast<uint8_t>( 31ul - __builtin_clzl( x ) );
+}
+#elif defined(__x86_64__)
+FORCE_INLINE uint8_t highestBitIdx( size_t x )
+{
+	return static_cast<uint8_t>( 63ull - __builtin_clzll( x ) );
+}
+#else
+#error Unknown 32/64 bits architecture
+#endif	
+
+#else
+#error Unknown compiler
+#endif
+
+// index of the lowest set bit; x != 0
+#if defined(_MSC_VER)
+#if defined(_M_IX86)
+FORCE_INLINE uint8_t lowestBitIdx( uint64_t x )
+{
+	unsigned long ix;
+	if ( (uint32_t)x != 0 )
+		_BitScanForward( &ix, (uint32_t)x );
+	else
+	{
+		_BitScanForward( &ix, (uint32_t)( x >> 32 ) );
+		ix += 32;
+	}
+	return static_cast<uint8_t>(ix);
+}
+#elif defined(_M_X64)
+FORCE_INLINE uint8_t lowestBitIdx( uint64_t x )
+{
+	unsigned long ix;
+	_BitScanForward64( &ix, x );
+	return static_cast<uint8_t>(ix);
+}
+#else
+#error Unknown 32/64 bits architecture
+#endif
+
+#elif defined(__GNUC__)
+FORCE_INLINE uint8_t lowestBitIdx( uint64_t x )
+{
+	return static_cast<uint8_t>( __builtin_ctzll( x ) );
+}
+
+#else
+#error Unknown compiler
+#endif
+
+// the same, to be used at compile time
+constexpr uint8_t highestBitIdxConstexpr( size_t x )
+{
+	uint8_t ret = 0;
+	while ( x >>= 1 )
+		++ret;
+	return ret;
+}
+
+
+// Each scheme has sizes of 8, 16, 32, ... , and a number of evenly spaced ones in between;
+// indexToBucketSize() is used once per page formatting, and sizeToIndex() on each allocation
+
+struct ExpBucketSizes
+{
+	static constexpr const char* name() { return "exp"; }
+
+	static constexpr
+	FORCE_INLINE size_t indexToBucketSize(uint8_t ix)
+	{
+		return 1ULL << (ix + 3);
+	}
+
+	// sz > 8, ix = highestBitIdx( sz - 1 )
+	static constexpr
+	FORCE_INLINE uint8_t sizeToIndexWithHighestBit(size_t sz, uint8_t ix)
+	{
+		return static_cast<uint8_t>( ix - 2 );
+	}
+
+	static
+	FORCE_INLINE uint8_t sizeToIndex(size_t sz)
+	{
+		return (sz <= 8) ? 0 : sizeToIndexWithHighestBit( sz, highestBitIdx( sz - 1 ) );
+	}
+};
+
+struct HalfExpBucketSizes
+{
+	static constexpr const char* name() { return "half-exp"; }
+
+	static constexpr
+	FORCE_INLINE size_t indexToBucketSize(uint8_t ix)
+	{
+		size_t ret = ( 1ULL << ((ix>>1) + 3) ) + ( ( ( ( ix + 1 ) & 1 ) - 1 ) & ( 1ULL << ((ix>>1) + 2) ) );
+		return alignUpExp( ret, 3 ); // this is because of case ix = 1, ret = 12 (keeping 8-byte alignment)
+	}
+
+	// sz > 8, ix = highestBitIdx( sz - 1 )
+	static constexpr
+	FORCE_INLINE uint8_t sizeToIndexWithHighestBit(size_t sz, uint8_t ix)
+	{
+		return static_cast<uint8_t>( ((ix-2)<<1) + ( 1 & ( (sz - 1) >> (ix-1) ) ) - 1 );
+	}
+
+	static
+	FORCE_INLINE uint8_t sizeToIndex(size_t sz)
+	{
+		return (sz <= 8) ? 0 : sizeToIndexWithHighestBit( sz, highestBitIdx( sz - 1 ) );
+	}
+};
+
+struct QuarterExpBucketSizes
+{
+	static constexpr const char* name() { return "quarter-exp"; }
+
+	static constexpr
+	FORCE_INLINE size_t indexToBucketSize(uint8_t ix)
+	{
+		ix += 3;
+		size_t ret = ( 4ULL << ((ix>>2)) ) + ((ix&3)+1) * (1ULL << ((ix>>2)));
+		return alignUpExp( ret, 3 ); // this is because of case ix = 1, ret = 12 (keeping 8-byte alignment), etc
+	}
+
+	// sz > 8, ix = highestBitIdx( sz - 1 )
+	static constexpr
+	FORCE_INLINE uint8_t sizeToIndexWithHighestBit(size_t sz, uint8_t ix)
+	{
+		return static_cast<uint8_t>( ((ix-2)<<2) + ( 3 & ( (sz - 1) >> (ix-2) ) ) - 3 );
+	}
+
+	static
+	FORCE_INLINE uint8_t sizeToIndex(size_t sz)
+	{
+		return (sz <= 8) ? 0 : sizeToIndexWithHighestBit( sz, highestBitIdx( sz - 1 ) );
+	}
+};
+
+
+// BucketSizesT with sizeToIndex() being a lookup into a table built at compile time for sizes up to table_max_size
+// (indexed by (sz + 7) >> 3, as sizes of buckets are multiples of 8), and BucketSizesT::sizeToIndex() above it.
+// Bucket sizes are the same as with BucketSizesT; indexes may only differ where a scheme has several buckets
+// of the same size (those of 16 bytes with HalfExpBucketSizes and QuarterExpBucketSizes)
+template<class BucketSizesT, size_t table_max_size>
+struct TableBucketSizes
+{
+	static_assert( ( table_max_size & 7 ) == 0, "" );
+	static constexpr size_t table_size = ( table_max_size >> 3 ) + 1;
+
+	struct Table
+	{
+		uint8_t idx[table_size];
+
+		constexpr Table() : idx()
+		{
+			for ( size_t i=0; i<table_size; ++i )
+			{
+				size_t sz = i << 3;
+				idx[i] = sz <= 8 ? 0 : BucketSizesT::sizeToIndexWithHighestBit( sz, highestBitIdxConstexpr( sz - 1 ) );
+			}
+		}
+	};
+	static constexpr Table table = Table();
+
+	static constexpr const char* name() { return BucketSizesT::name(); }
+
+	static constexpr
+	FORCE_INLINE size_t indexToBucketSize(uint8_t ix)
+	{
+		return BucketSizesT::indexToBucketSize( ix );
+	}
+
+	static
+	FORCE_INLINE uint8_t sizeToIndex(size_t sz)
+	{
+		if ( sz <= table_max_size )
+			return table.idx[ ( sz + 7 ) >> 3 ];
+		return BucketSizesT::sizeToIndex( sz );
+	}
+};
+
+template<class BucketSizesT, size_t table_max_size>
+constexpr typename TableBucketSizes<BucketSizesT, table_max_size>::Table TableBucketSizes<BucketSizesT, table_max_size>::table;
+
+#endif // BUCKET_SIZES_H
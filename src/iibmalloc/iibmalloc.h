@@ -38,14 +38,20 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <new>
 #include <vector> // potentially, a temporary solution
 
 #include "iibmalloc_common.h"
 #include "page_allocator.h"
+#include "page_purger.h"
+#include "bucket_sizes.h"
 
 
-class SerializableAllocatorBase;
-extern thread_local SerializableAllocatorBase g_AllocManager;
+// heaps initialized while it is set back their reservations with huge pages (see SoundingAddressPageAllocator);
+// initially, it is set with IIBMALLOC_HUGE_PAGES=1 environment variable
+extern std::atomic<bool> g_UseHugePages;
 
 
 constexpr size_t ALIGNMENT = 2 * sizeof(uint64_t);
@@ -64,6 +70,74 @@ static_assert( 1 + PAGE_SIZE_MASK == PAGE_SIZE, "" );
 //#define USE_ITEM_HEADER
 #define USE_SOUNDING_PAGE_ADDRESS
 
+
+// Process-wide map from each (1 << region_size_exp)-aligned region of the address space to the heap owning it.
+// Heaps register their reservations (one or more aligned regions) and bulk blocks (exactly one aligned region) here,
+// so that a pointer can be routed back to its owning heap when deallocated by a different thread.
+// Leaves are allocated on demand and are never released.
+class RegionOwnerMap
+{
+public:
+	static constexpr size_t region_size_exp = 23;
+	static constexpr size_t region_size = ((size_t)1) << region_size_exp;
+
+private:
+	static constexpr size_t address_bits = 48;
+	static constexpr size_t leaf_exp = 12;
+	static constexpr size_t leaf_size = ((size_t)1) << leaf_exp;
+	static constexpr size_t root_size = ((size_t)1) << (address_bits - region_size_exp - leaf_exp);
+
+	typedef std::atomic<void*> Entry;
+	std::atomic<Entry*> root[root_size]; // zero-initialized as long as the object is a global
+
+	static FORCE_INLINE uintptr_t ptrToRegionIdx( const void* ptr ) 
+	{
+		uintptr_t idx = (uintptr_t)(ptr) >> region_size_exp;
+		assert( idx < root_size * leaf_size );
+		return idx;
+	}
+
+	Entry* getOrCreateLeaf( uintptr_t regionIdx )
+	{
+		std::atomic<Entry*>& leafRef = root[ regionIdx >> leaf_exp ];
+		Entry* leaf = leafRef.load( std::memory_order_acquire );
+		if ( leaf != nullptr )
+			return leaf;
+		constexpr size_t leafBytes = alignUpExp( sizeof( Entry ) * leaf_size, PAGE_SIZE_EXP );
+		Entry* newLeaf = reinterpret_cast<Entry*>( VirtualMemory::allocate( leafBytes ) ); // zeroed
+		if ( leafRef.compare_exchange_strong( leaf, newLeaf, std::memory_order_acq_rel ) )
+			return newLeaf;
+		VirtualMemory::deallocate( newLeaf, leafBytes ); // somebody else was faster
+		return leaf;
+	}
+
+public:
+	void setOwner( void* region, void* owner )
+	{
+		assert( ( (uintptr_t)(region) & (region_size - 1) ) == 0 );
+		uintptr_t regionIdx = ptrToRegionIdx( region );
+		getOrCreateLeaf( regionIdx )[ regionIdx & (leaf_size - 1) ].store( owner, std::memory_order_release );
+	}
+
+	void setOwnerOfRange( void* start, size_t size, void* owner )
+	{
+		assert( ( size & (region_size - 1) ) == 0 );
+		for ( size_t i=0; i<size; i+=region_size )
+			setOwner( reinterpret_cast<uint8_t*>( start ) + i, owner );
+	}
+
+	FORCE_INLINE void* getOwner( const void* ptr ) const
+	{
+		uintptr_t regionIdx = ptrToRegionIdx( ptr );
+		Entry* leaf = root[ regionIdx >> leaf_exp ].load( std::memory_order_acquire );
+		if ( leaf == nullptr )
+			return nullptr;
+		return leaf[ regionIdx & (leaf_size - 1) ].load( std::memory_order_acquire );
+	}
+};
+
+extern RegionOwnerMap g_RegionOwnerMap;
+
 template<class BasePageAllocator, class ItemT>
 class CollectionInPages : public BasePageAllocator
 {
@@ -125,6 +199,23 @@ public:
 //		head->next = freeList;
 		return &(head->item);
 	}
+	// linear in the number of items; returns false if not found
+	bool remove( const ItemT& item )
+	{
+		ListItem** prevNext = &head;
+		for ( ListItem* curr = head; curr != nullptr; curr = curr->next )
+		{
+			if ( curr->item == item )
+			{
+				*prevNext = curr->next;
+				curr->next = freeList;
+				freeList = curr;
+				return true;
+			}
+			prevNext = &(curr->next);
+		}
+		return false;
+	}
 	template<class Functor>
 	void doForEach(Functor& f)
 	{
@@ -188,36 +279,153 @@ class SoundingAddressPageAllocator : public BasePageAllocator
 	PageBlockDescriptor pageBlockListStart;
 	PageBlockDescriptor* pageBlockListCurrent;
 	PageBlockDescriptor* indexHead[bucket_cnt];
+	void* regionOwner = nullptr;
+
+	// Optionally, reservations are committed right away as huge pages (hugetlbfs ones, or transparent ones as a fallback),
+	// each huge page holding a number of whole buckets, so that the address-to-bucket mapping is kept as is.
+	// Physical memory is then taken by a whole huge page on first access to any of its buckets, so up to
+	// max_huge_page_reservations reservations (of all heaps together) are backed with huge pages, and further ones are
+	// regular. Empty spans of a huge page are not decommitted one by one (that would split it); instead, the huge page
+	// is decommitted as a whole once none of its spans are in use, and its spans are then handled as regular ones.
+	static constexpr size_t huge_page_size_exp = 21;
+	static_assert( reservation_size_exp >= huge_page_size_exp, "a reservation must consist of whole huge pages" );
+	static constexpr size_t huge_pages_per_reservation = ((size_t)1) << ( reservation_size_exp - huge_page_size_exp );
+	static constexpr size_t max_huge_page_reservations = 16;
+	static inline std::atomic<size_t> hugePageReservationCnt{ 0 };
+	bool useHugePages = false;
+
+	// Reservations are split into spans of multipage_page_cnt pages; a span is what getMultipage() returns, and is formatted
+	// into items of a single bucket. Live items of each span are counted, so that spans with no live items can be
+	// decommitted (right away or by g_PagePurger) and later reused for the same bucket. Counters of a reservation are kept
+	// in the first pages of its last bucket, which is never requested for items.
+	// A free list of a bucket (SerializableAllocator::buckets) holds items of a single span, the current one of the bucket;
+	// items of other spans are deallocated to free lists of their spans, and such spans are listed in partialSpans, so that
+	// a span going empty holds all of its free items and can be released without looking for them elsewhere.
+	static constexpr size_t span_size_exp = multipage_page_cnt_exp + PAGE_SIZE_EXP;
+	static constexpr size_t span_size = ((size_t)1) << span_size_exp;
+	static constexpr size_t spans_per_reservation = reservation_size >> span_size_exp;
+	static_assert( pages_per_bucket % multipage_page_cnt == 0, "spans must not cross buckets" );
+	static constexpr uint16_t released_span_mark = UINT16_MAX; // possibly, still committed
+	static constexpr uint16_t purged_span_mark = PagePurger::purged_mark;
+	static_assert( ( span_size >> ALIGNMENT_EXP ) < PagePurger::purging_mark, "" );
+	static constexpr size_t spans_per_huge_page = ((size_t)1) << ( huge_page_size_exp - span_size_exp );
+	struct SpanHeader
+	{
+		bool hugePages; // the reservation is backed with huge pages
+		bool hugePageReleased[huge_pages_per_reservation]; // its spans are then regular ones
+		uint16_t heldSpanCnt[huge_pages_per_reservation]; // spans of a huge page taken by getMultipage() and not released
+		uint16_t liveCount[spans_per_reservation];
+		void* freeList[spans_per_reservation]; // items deallocated while the span is not the current one of its bucket
+		void* next[spans_per_reservation]; // in releasedSpans or in partialSpans
+		void* prev[spans_per_reservation]; // in partialSpans
+	};
+	static constexpr size_t span_header_size = alignUpExp( sizeof( SpanHeader ), PAGE_SIZE_EXP );
+	static_assert( span_header_size <= ( pages_per_bucket << PAGE_SIZE_EXP ), "" );
+	// hysteresis: up to max_empty_spans empty spans of a bucket are kept, so that a bucket hovering around a page boundary is not thrashed
+	static constexpr size_t max_empty_spans = 4;
+	size_t emptySpanCnt[bucket_cnt]; // formatted spans with no live items
+	void* currentSpan[bucket_cnt];
+	void* partialSpans[bucket_cnt]; // spans other than the current one with items in their own free lists, linked via SpanHeader::next/prev
+	void* releasedSpans[bucket_cnt]; // released spans to be reused first, linked via SpanHeader::next
+
+	static FORCE_INLINE SpanHeader* spanHeader( void* ptr )
+	{
+		uintptr_t reservation = alignDownExp( (uintptr_t)(ptr), reservation_size_exp );
+		return reinterpret_cast<SpanHeader*>( reservation + ( (bucket_cnt - 1) << (pages_per_bucket_exp + PAGE_SIZE_EXP) ) );
+	}
+	static FORCE_INLINE size_t spanIdx( void* ptr ) { return ( (uintptr_t)(ptr) & (reservation_size - 1) ) >> span_size_exp; }
+	static FORCE_INLINE void* spanStart( void* ptr ) { return (void*)( alignDownExp( (uintptr_t)(ptr), span_size_exp ) ); }
+	static FORCE_INLINE size_t hugePageIdx( void* ptr ) { return ( (uintptr_t)(ptr) & (reservation_size - 1) ) >> huge_page_size_exp; }
+	static bool isOnHugePage( void* ptr )
+	{
+		SpanHeader* h = spanHeader( ptr );
+		return h->hugePages && !h->hugePageReleased[ hugePageIdx( ptr ) ];
+	}
+
+	static bool takeHugePageReservation()
+	{
+		size_t cnt = hugePageReservationCnt.load( std::memory_order_relaxed );
+		while ( cnt < max_huge_page_reservations )
+			if ( hugePageReservationCnt.compare_exchange_weak( cnt, cnt + 1, std::memory_order_relaxed ) )
+				return true;
+		return false;
+	}
 
 	void* getNextBlock()
 	{
-		void* pages = this->AllocateAddressSpace( reservation_size );
+		static_assert( reservation_size_exp >= RegionOwnerMap::region_size_exp, "reservations are expected to consist of whole owner map regions" );
+		void* pages;
+		if ( useHugePages && takeHugePageReservation() )
+		{
+			pages = this->AllocateHugeAlignedMemory( reservation_size, reservation_size_exp ); // zeroed
+			SpanHeader* h = spanHeader( pages );
+			h->hugePages = true;
+			h->heldSpanCnt[ hugePageIdx( h ) ] = 1; // span counters are in use as long as the reservation is
+		}
+		else
+		{
+			pages = this->AllocateAlignedAddressSpace( reservation_size, reservation_size_exp );
+			this->CommitMemory( spanHeader( pages ), span_header_size ); // zeroed
+		}
+		g_RegionOwnerMap.setOwnerOfRange( pages, reservation_size, regionOwner );
 		return pages;
 	}
 
-	void* createNextBlockAndGetPage( size_t reasonIdx )
+	void createNextBlock()
 	{
-		assert( reasonIdx < bucket_cnt );
-//		PageBlockDescriptor* pb = new PageBlockDescriptor; // TODO: consider using our own allocator
 		PageBlockDescriptor* pb = pageBlockDescriptors.createNew();
 		pb->blockAddress = getNextBlock();
-//printf( "createNextBlockAndGetPage(): descriptor allocated at 0x%zx; block = 0x%zx\n", (size_t)(pb), (size_t)(pb->blockAddress) );
 		memset( pb->nextToUse, 0, sizeof( uint16_t) * bucket_cnt );
 		memset( pb->nextToCommit, 0, sizeof( uint16_t) * bucket_cnt );
 		pb->next = nullptr;
 		pageBlockListCurrent->next = pb;
 		pageBlockListCurrent = pb;
-//		void* ret = idxToPageAddr( pb->blockAddress, reasonIdx );
-		void* ret = idxToPageAddr( pb->blockAddress, reasonIdx, 0 );
-//	printf("createNextBlockAndGetPage(): before commit, %zd, 0x%zx -> 0x%zx\n", reasonIdx, (size_t)(pb->blockAddress), (size_t)(ret) );
-//		void* ret2 = this->CommitMemory( ret, PAGE_SIZE );
-//		this->CommitMemory( ret, PAGE_SIZE );
-		commitRangeOfPageIndexes( pb->blockAddress, reasonIdx, 0, commit_page_cnt );
-		pb->nextToUse[ reasonIdx ] = 1;
-		static_assert( commit_page_cnt <= UINT16_MAX, "" );
-		pb->nextToCommit[ reasonIdx ] = (uint16_t)commit_page_cnt;
-*reinterpret_cast<uint8_t*>(ret) += 1; // test write
-//	printf("createNextBlockAndGetPage(): after commit 0x%zx\n", (size_t)(ret2) );
+	}
+
+	// Pages of a bucket within a reservation are contiguous (as reservations are aligned), so a span is taken as a whole,
+	// and its pages (if not yet committed) are committed with a single syscall, commit_page_cnt of them at a time
+	void* getNextSpan( size_t idx, size_t& syscallCnt )
+	{
+		PageBlockDescriptor* pb = indexHead[idx];
+		if ( pb->nextToUse[idx] == pages_per_bucket )
+		{
+			if ( pb->next == nullptr ) // next block is to be created
+			{
+				assert( pb == pageBlockListCurrent );
+				createNextBlock();
+				syscallCnt += spanHeader( pageBlockListCurrent->blockAddress )->hugePages ? 1 : 2; // reserving, and committing span counters
+			}
+			pb = pb->next;
+			indexHead[idx] = pb;
+			assert( pb->blockAddress );
+			assert( pb->nextToUse[idx] == 0 && pb->nextToCommit[idx] == 0 );
+		}
+		if ( spanHeader( pb->blockAddress )->hugePages )
+		{
+			void* ret = idxToPageAddr( pb->blockAddress, idx, pb->nextToUse[idx] );
+			pb->nextToUse[idx] += multipage_page_cnt;
+			pb->nextToCommit[idx] = pb->nextToUse[idx];
+			if ( isOnHugePage( ret ) )
+				++(spanHeader( ret )->heldSpanCnt[ hugePageIdx( ret ) ]);
+			else
+			{
+				this->CommitMemory( ret, span_size );
+				++syscallCnt;
+			}
+			return ret;
+		}
+		static_assert( commit_page_cnt % multipage_page_cnt == 0 && pages_per_bucket % commit_page_cnt == 0, "" );
+		assert( pb->nextToUse[idx] % multipage_page_cnt == 0 );
+		if ( pb->nextToUse[idx] == pb->nextToCommit[idx] )
+		{
+			this->CommitMemory( idxToPageAddr( pb->blockAddress, idx, pb->nextToCommit[idx] ), commit_size );
+			++syscallCnt;
+			pb->nextToCommit[idx] += commit_page_cnt;
+		}
+		void* ret = idxToPageAddr( pb->blockAddress, idx, pb->nextToUse[idx] );
+		pb->nextToUse[idx] += multipage_page_cnt;
+		assert( pb->nextToUse[idx] <= pb->nextToCommit[idx] );
+		assert( ret == spanStart( ret ) );
 		return ret;
 	}
 
@@ -233,6 +441,39 @@ class SoundingAddressPageAllocator : public BasePageAllocator
 		pageBlockListCurrent = &pageBlockListStart;
 		for ( size_t i=0; i<bucket_cnt; ++i )
 			indexHead[i] = pageBlockListCurrent;
+
+		memset( emptySpanCnt, 0, sizeof( emptySpanCnt ) );
+		memset( currentSpan, 0, sizeof( currentSpan ) );
+		memset( partialSpans, 0, sizeof( partialSpans ) );
+		memset( releasedSpans, 0, sizeof( releasedSpans ) );
+	}
+
+	void addToPartialSpans( size_t idx, void* span )
+	{
+		SpanHeader* h = spanHeader( span );
+		size_t si = spanIdx( span );
+		h->prev[si] = nullptr;
+		h->next[si] = partialSpans[idx];
+		if ( partialSpans[idx] != nullptr )
+			spanHeader( partialSpans[idx] )->prev[ spanIdx( partialSpans[idx] ) ] = span;
+		partialSpans[idx] = span;
+	}
+
+	void removeFromPartialSpans( size_t idx, void* span )
+	{
+		SpanHeader* h = spanHeader( span );
+		size_t si = spanIdx( span );
+		void* prev = h->prev[si];
+		void* next = h->next[si];
+		if ( prev != nullptr )
+			spanHeader( prev )->next[ spanIdx( prev ) ] = next;
+		else
+		{
+			assert( partialSpans[idx] == span );
+			partialSpans[idx] = next;
+		}
+		if ( next != nullptr )
+			spanHeader( next )->prev[ spanIdx( next ) ] = prev;
 	}
 
 public:
@@ -282,143 +523,158 @@ public:
 		resetLists();
 	}
 
-	void commitRangeOfPageIndexes( void* blockptr, size_t bucketIdx, size_t pageIdx, size_t rangeSize )
+	void setRegionOwner( void* owner ) { regionOwner = owner; }
+	void setHugePages( bool use ) { assert( pageBlockListStart.next == nullptr ); useHugePages = use; } // before any reservation is made
+
+	// a free list of a partial span of the bucket, which becomes the current one, or nullptr if there are none
+	// (the current span is then to be replaced with one of getMultipage())
+	void* takePartialSpan( size_t idx )
+	{
+		void* span = partialSpans[idx];
+		if ( span == nullptr )
+			return nullptr;
+		removeFromPartialSpans( idx, span );
+		SpanHeader* h = spanHeader( span );
+		size_t si = spanIdx( span );
+		void* ret = h->freeList[si];
+		assert( ret != nullptr );
+		h->freeList[si] = nullptr;
+		currentSpan[idx] = span;
+		return ret;
+	}
+
+	// the span returned becomes the current one of the bucket
+	void getMultipage( size_t idx, MultipageData& mpData )
 	{
-		uint8_t* start = reinterpret_cast<uint8_t*>( idxToPageAddr( blockptr, bucketIdx, pageIdx ) );
-		uint8_t* prevNext = start;
-		uint8_t* next;
-		for ( size_t i=1; i<rangeSize; ++i )
+		assert( idx < bucket_cnt - 1 ); // the last bucket holds span counters
+		assert( partialSpans[idx] == nullptr );
+		uint64_t start = __rdtsc();
+		size_t syscallCnt = 0;
+		++(emptySpanCnt[idx]); // to be formatted right away
+		if ( releasedSpans[idx] != nullptr )
 		{
-			next = reinterpret_cast<uint8_t*>( idxToPageAddr( blockptr, bucketIdx, pageIdx + i ) );
-			if ( next - prevNext == PAGE_SIZE )
+			void* span = releasedSpans[idx];
+			SpanHeader* h = spanHeader( span );
+			size_t si = spanIdx( span );
+			releasedSpans[idx] = h->next[si];
+			if ( isOnHugePage( span ) )
 			{
-				prevNext = next;
-				continue;
+				assert( h->liveCount[si] == released_span_mark );
+				++(h->heldSpanCnt[ hugePageIdx( span ) ]);
 			}
-			else
+			else if ( !g_PagePurger.takeBack( span, h->liveCount + si ) )
 			{
-				this->CommitMemory( start, prevNext - start + PAGE_SIZE );
-				start = next;
-				prevNext = next;
+				this->CommitMemory( span, span_size );
+				++syscallCnt;
 			}
+			assert( h->liveCount[si] == released_span_mark || h->liveCount[si] == purged_span_mark );
+			h->liveCount[si] = 0;
+			mpData.ptr1 = span;
 		}
-		this->CommitMemory( start, prevNext - start + PAGE_SIZE );
+		else
+			mpData.ptr1 = getNextSpan( idx, syscallCnt );
+		assert( spanHeader( mpData.ptr1 )->freeList[ spanIdx( mpData.ptr1 ) ] == nullptr );
+		currentSpan[idx] = mpData.ptr1;
+		mpData.sz1 = span_size;
+		mpData.ptr2 = nullptr;
+		mpData.sz2 = 0;
+		this->stats.registerRefill( syscallCnt, __rdtsc() - start );
 	}
 
-	void* getPage( size_t idx )
+	FORCE_INLINE void registerAllocated( void* ptr, size_t idx )
 	{
-		assert( idx < bucket_cnt );
-		assert( indexHead[idx] );
-		if ( indexHead[idx]->nextToUse[idx] < pages_per_bucket )
-		{
-			assert( indexHead[idx]->nextToUse[idx] <= indexHead[idx]->nextToCommit[idx] );
-			if ( indexHead[idx]->nextToUse[idx] == indexHead[idx]->nextToCommit[idx] )
-			{
-				commitRangeOfPageIndexes( indexHead[idx]->blockAddress, idx, indexHead[idx]->nextToCommit[idx], commit_page_cnt );
-				indexHead[idx]->nextToCommit[ idx ] += commit_page_cnt;
-			}
-			void* ret = idxToPageAddr( indexHead[idx]->blockAddress, idx, indexHead[idx]->nextToUse[idx] );
-			++(indexHead[idx]->nextToUse[idx]);
-			assert( indexHead[idx]->nextToUse[idx] <= indexHead[idx]->nextToCommit[idx] );
-//			this->CommitMemory( ret, PAGE_SIZE );
-*reinterpret_cast<uint8_t*>(ret) += 1; // test write
-			return ret;
-		}
-		else if ( indexHead[idx]->next == nullptr ) // next block is to be created
-		{
-			assert( indexHead[idx] == pageBlockListCurrent );
-			void* ret = createNextBlockAndGetPage( idx );
-			indexHead[idx] = pageBlockListCurrent;
-			assert( indexHead[idx]->next == nullptr );
-*reinterpret_cast<uint8_t*>(ret) += 1; // test write
-			return ret;
-		}
-		else // next block is just to be used first time
-		{
-			indexHead[idx] = indexHead[idx]->next;
-			assert( indexHead[idx]->blockAddress );
-//			assert( ( indexHead[idx]->usageMask & ( ((size_t)1) << idx ) ) == 0 );
-//			indexHead[idx]->usageMask |= ((size_t)1) << idx;
-//			void* ret = idxToPageAddr( indexHead[idx]->blockAddress, idx );
-			assert( indexHead[idx]->nextToUse[idx] == 0 );
-			assert( indexHead[idx]->nextToCommit[idx] == 0 );
-			if ( indexHead[idx]->nextToUse[idx] == indexHead[idx]->nextToCommit[idx] )
-			commitRangeOfPageIndexes( indexHead[idx]->blockAddress, idx, indexHead[idx]->nextToCommit[idx], commit_page_cnt );
-			indexHead[idx]->nextToCommit[idx] = commit_page_cnt;
-			void* ret = idxToPageAddr( indexHead[idx]->blockAddress, idx, indexHead[idx]->nextToUse[idx] );
-			indexHead[idx]->nextToUse[idx] = 1;
-			assert( indexHead[idx]->nextToUse[idx] <= indexHead[idx]->nextToCommit[idx] );
-//	printf("getPage(): before commit, %zd, 0x%zx -> 0x%zx\n", idx, (size_t)(indexHead[idx]->blockAddress), (size_t)(ret) );
-//			void* ret2 = this->CommitMemory( ret, PAGE_SIZE );
-//	printf("getPage(): after commit 0x%zx\n", (size_t)(ret2) );
-//			this->CommitMemory( ret, PAGE_SIZE );
-*reinterpret_cast<uint8_t*>(ret) += 1; // test write
-			return ret;
-		}
+		uint16_t& cnt = spanHeader( ptr )->liveCount[ spanIdx( ptr ) ];
+		assert( cnt < purged_span_mark - 1 );
+		if ( ++cnt == 1 )
+			--(emptySpanCnt[idx]);
 	}
 
-	void getMultipage( size_t idx, MultipageData& mpData )
+	FORCE_INLINE bool isCurrentSpan( void* ptr, size_t idx ) const { return spanStart( ptr ) == currentSpan[idx]; }
+
+	// for items of the current span, which go to a free list of the bucket
+	FORCE_INLINE void registerDeallocated( void* ptr, size_t idx )
 	{
-		// NOTE: current implementation just sits over repeated calls to getPage()
-		//       it is reasonably assumed that returned pages are within at most two connected segments
-		// TODO: it's possible to make it more optimal just by writing fram scratches by analogy with getPage() and calls from it
-		mpData.ptr1 = getPage( idx );
-		if constexpr ( multipage_page_cnt == 1 )
-		{
-			asserrt( mpData.ptr1 );
-			mpData.sz1 = PAGE_SIZE;
-			mpData.ptr2 = nullptr;
-			mpData.sz2 = 0;
-			assert( mpData.sz1 + mpData.sz2 == ( multipage_page_cnt << PAGE_SIZE_EXP ) );
-			return;
-		}
+		assert( isCurrentSpan( ptr, idx ) );
+		uint16_t& cnt = spanHeader( ptr )->liveCount[ spanIdx( ptr ) ];
+		assert( cnt != 0 && cnt < purged_span_mark );
+		if ( --cnt == 0 )
+			++(emptySpanCnt[idx]); // the current span is kept anyway
+	}
 
-		void* nextPage;
-		size_t i=1;
-		mpData.sz1 = PAGE_SIZE;
-		for ( ; i<multipage_page_cnt; ++i )
-		{
-			nextPage = getPage( idx );
-			assert( nextPage );
-			if ( reinterpret_cast<uint8_t*>(mpData.ptr1) + mpData.sz1 == reinterpret_cast<uint8_t*>(nextPage) )
-				mpData.sz1 += PAGE_SIZE;
-			else break;
-		}
-		if ( i == multipage_page_cnt )
+	// for items of other spans, which go to free lists of their spans; a span going empty beyond max_empty_spans is released
+	FORCE_INLINE void deallocateToSpan( void* ptr, size_t idx )
+	{
+		assert( !isCurrentSpan( ptr, idx ) );
+		SpanHeader* h = spanHeader( ptr );
+		size_t si = spanIdx( ptr );
+		assert( h->liveCount[si] != 0 && h->liveCount[si] < purged_span_mark );
+		void* head = h->freeList[si];
+		*reinterpret_cast<void**>( ptr ) = head;
+		h->freeList[si] = ptr;
+		if ( head == nullptr )
+			addToPartialSpans( idx, spanStart( ptr ) );
+		if ( --(h->liveCount[si]) == 0 && ++(emptySpanCnt[idx]) > max_empty_spans )
+			releaseEmptySpan( idx, spanStart( ptr ) );
+	}
+
+	// all items of an empty span other than the current one are in its own free list, so the span is not accessed any longer
+	NOINLINE void releaseEmptySpan( size_t idx, void* span )
+	{
+		SpanHeader* h = spanHeader( span );
+		size_t si = spanIdx( span );
+		assert( h->liveCount[si] == 0 && h->freeList[si] != nullptr );
+		removeFromPartialSpans( idx, span );
+		h->freeList[si] = nullptr;
+		h->liveCount[si] = released_span_mark;
+		--(emptySpanCnt[idx]);
+		freePage( idx, span );
+	}
+
+	// a span is decommitted (right away, or later by g_PagePurger), and is to be reused for the same bucket by getMultipage()
+	void freePage( size_t idx, void* span )
+	{
+		assert( span == spanStart( span ) );
+		SpanHeader* h = spanHeader( span );
+		size_t si = spanIdx( span );
+		assert( h->liveCount[si] == released_span_mark );
+		if ( isOnHugePage( span ) )
 		{
-			mpData.ptr2 = nullptr;
-			mpData.sz2 = 0;
-			assert( mpData.sz1 + mpData.sz2 == ( multipage_page_cnt << PAGE_SIZE_EXP ) );
-			return;
+			if ( --(h->heldSpanCnt[ hugePageIdx( span ) ]) == 0 )
+				releaseHugePage( span );
 		}
-		mpData.ptr2 = nextPage;
-		mpData.sz2 = PAGE_SIZE;
-		++i;
-		for ( ; i<multipage_page_cnt; ++i )
+		else if ( !g_PagePurger.addForDecommit( span, span_size, this, h->liveCount + si ) )
 		{
-			nextPage = getPage( idx );
-			assert( nextPage );
-			if ( reinterpret_cast<uint8_t*>(mpData.ptr2) + mpData.sz2 == reinterpret_cast<uint8_t*>(nextPage) )
-				mpData.sz2 += PAGE_SIZE;
-			else break;
+			this->DecommitMemory( span, span_size );
+			h->liveCount[si] = purged_span_mark;
 		}
-		assert( i == multipage_page_cnt );
-		assert( mpData.sz1 + mpData.sz2 == ( multipage_page_cnt << PAGE_SIZE_EXP ) );
+		h->next[si] = releasedSpans[idx];
+		releasedSpans[idx] = span;
 	}
 
-	void freePage( MemoryBlockListItem* chk )
+	// spans of the huge page are either released (and are to be committed again when reused) or not taken yet
+	NOINLINE void releaseHugePage( void* ptr )
 	{
-		assert( false );
-		// TODO: decommit
+		SpanHeader* h = spanHeader( ptr );
+		size_t hpIdx = hugePageIdx( ptr );
+		void* hugePage = (void*)( alignDownExp( (uintptr_t)(ptr), huge_page_size_exp ) );
+		this->DecommitMemory( hugePage, ((size_t)1) << huge_page_size_exp );
+		h->hugePageReleased[hpIdx] = true;
+		for ( size_t si=hpIdx*spans_per_huge_page; si<(hpIdx+1)*spans_per_huge_page; ++si )
+			if ( h->liveCount[si] == released_span_mark )
+				h->liveCount[si] = purged_span_mark;
 	}
 
 	void deinitialize()
 	{
+		g_PagePurger.forgetOwner( this );
 		PageBlockDescriptor* next = pageBlockListStart.next;
 		while( next )
 		{
 //printf( "in block 0x%zx about to delete 0x%zx of size 0x%zx\n", (size_t)( next ), (size_t)( next->blockAddress ), PAGE_SIZE * bucket_cnt );
 			assert( next->blockAddress );
+			if ( spanHeader( next->blockAddress )->hugePages )
+				hugePageReservationCnt.fetch_sub( 1, std::memory_order_relaxed );
+			g_RegionOwnerMap.setOwnerOfRange( next->blockAddress, reservation_size, nullptr );
 			this->freeChunkNoCache( reinterpret_cast<MemoryBlockListItem*>( next->blockAddress ), reservation_size );
 			PageBlockDescriptor* tmp = next->next;
 //			delete next;
@@ -442,7 +698,12 @@ class BulkAllocator : public BasePageAllocator
 	static_assert( ( commited_block_size >> PAGE_SIZE_EXP ) > 0 );
 	static_assert( ( commited_block_size & PAGE_SIZE_MASK ) == 0 );
 	static_assert( max_pages < PAGE_SIZE );
+	static_assert( max_pages < 64, "free lists are tracked by a 64-bit mask" );
 	static constexpr size_t pagesPerAllocatedBlock = commited_block_size >> PAGE_SIZE_EXP;
+	static constexpr uint8_t commited_block_size_exp = sizeToExp( commited_block_size );
+	static_assert( ( ((size_t)1) << commited_block_size_exp ) == commited_block_size );
+	static_assert( commited_block_size == RegionOwnerMap::region_size, "blocks are expected to match owner map regions" );
+	static constexpr size_t retained_empty_blocks = 1; // entirely free blocks kept instead of being released, against map/unmap thrashing
 
 public:
 	struct AnyChunkHeader
@@ -481,6 +742,9 @@ private:
 		FreeChunkHeader* nextFree;
 	};
 	FreeChunkHeader* freeListBegin[ max_pages + 1 ];
+	uint64_t nonEmptyFreeLists; // bit i is set iff freeListBegin[i] != nullptr
+	size_t emptyBlockCnt;
+	void* regionOwner = nullptr;
 
 	void removeFromFreeList( FreeChunkHeader* item )
 	{
@@ -498,6 +762,8 @@ private:
 			freeListBegin[idx] = item->nextFree;
 			if ( freeListBegin[idx] != nullptr )
 				freeListBegin[idx]->prevFree = nullptr;
+			else
+				nonEmptyFreeLists &= ~( ((uint64_t)1) << idx );
 		}
 		if ( item->nextFree )
 		{
@@ -506,6 +772,19 @@ private:
 		}
 	}
 
+	void addToFreeList( FreeChunkHeader* item )
+	{
+		uint16_t idx = item->getPageCount() - 1;
+		if ( idx >= max_pages )
+			idx = max_pages;
+		item->prevFree = nullptr;
+		item->nextFree = freeListBegin[idx];
+		if ( freeListBegin[idx] != nullptr )
+			freeListBegin[idx]->prevFree = item;
+		freeListBegin[idx] = item;
+		nonEmptyFreeLists |= ((uint64_t)1) << idx;
+	}
+
 	void dbgValidateBlock( const AnyChunkHeader* h )
 	{
 		assert( h != nullptr );
@@ -544,8 +823,8 @@ private:
 
 	void dbgValidateAllBlocks()
 	{
-		class F { private: BulkAllocator<BasePageAllocator, commited_block_size, max_pages>* me; public: F(BulkAllocator<BasePageAllocator, commited_block_size, max_pages>*me_) {me = me_;} void f(AnyChunkHeader* h) {assert( blockList[i] != nullptr ); me->dbgValidateBlock( h ); } }; F f(this);
-		blocks.doForEachBlock( f );
+		class F { private: BulkAllocator<BasePageAllocator, commited_block_size, max_pages>* me; public: F(BulkAllocator<BasePageAllocator, commited_block_size, max_pages>*me_) {me = me_;} void f(AnyChunkHeader* h) {assert( h != nullptr ); me->dbgValidateBlock( h ); } }; F f(this);
+		blocks.doForEach( f );
 /*		for ( size_t i=0; i<blockList.size(); ++i )
 		{
 			AnyChunkHeader* start = reinterpret_cast<AnyChunkHeader*>( blockList[i] );
@@ -576,11 +855,23 @@ private:
 		}
 	}
 
+	// the block is entirely free and not in free lists
+	void releaseBlock( AnyChunkHeader* h )
+	{
+		assert( h->prevInBlock() == nullptr && h->nextInBlock() == nullptr );
+		bool found = blocks.remove( h );
+		assert( found );
+		g_RegionOwnerMap.setOwner( h, nullptr );
+		if ( !g_PagePurger.addForUnmap( h, commited_block_size ) )
+			this->freeChunkNoCache( h, commited_block_size );
+	}
+
 	void dbgValidateAllFreeLists()
 	{
 		for ( uint16_t i=0; i<=max_pages; ++i )
 		{
 			FreeChunkHeader* h = freeListBegin[i];
+			assert( ( h != nullptr ) == ( ( nonEmptyFreeLists >> i ) & 1 ) );
 			if ( h !=nullptr )
 				dbgValidateFreeList( h, i + 1 );
 		}
@@ -592,6 +883,8 @@ public:
 		BasePageAllocator::initialize( blockSizeExp );
 		for ( size_t i=0; i<=max_pages; ++i )
 			freeListBegin[i] = nullptr;
+		nonEmptyFreeLists = 0;
+		emptyBlockCnt = 0;
 //		new ( &blockList ) std::vector<AnyChunkHeader*>;
 		blocks.initialize( PAGE_SIZE_EXP );
 #ifdef BULKALLOCATOR_HEAVY_DEBUG
@@ -600,6 +893,8 @@ public:
 #endif
 	}
 
+	void setRegionOwner( void* owner ) { regionOwner = owner; }
+
 	AnyChunkHeader* allocate( size_t szIncludingHeader )
 	{
 #ifdef BULKALLOCATOR_HEAVY_DEBUG
@@ -616,67 +911,52 @@ public:
 			assert( pageCount <= UINT16_MAX );
 			assert( pageCount <= max_pages );
 
-			if ( freeListBegin[pageCount - 1] == nullptr )
+			// the smallest non-empty free list with chunks large enough (best fit); the last one holds chunks of any size above max_pages
+			uint64_t fitting = nonEmptyFreeLists & ( ~((uint64_t)0) << ( pageCount - 1 ) );
+			if ( fitting == 0 )
 			{
-				if ( freeListBegin[ max_pages ] == nullptr )
-				{
-					FreeChunkHeader* h = reinterpret_cast<FreeChunkHeader*>( this->getFreeBlockNoCache( commited_block_size ) );
-					assert( h!= nullptr );
-//					blockList.push_back( h );
-					*(blocks.createNew()) = h;
-					freeListBegin[ max_pages ] = h;
-					freeListBegin[ max_pages ]->set( nullptr, nullptr, pagesPerAllocatedBlock, true );
-					freeListBegin[ max_pages ]->nextFree = nullptr;
-					freeListBegin[ max_pages ]->prevFree = nullptr;
-				}
+				FreeChunkHeader* h = reinterpret_cast<FreeChunkHeader*>( this->getFreeAlignedBlockNoCache( commited_block_size, commited_block_size_exp ) );
+				assert( h!= nullptr );
+				g_RegionOwnerMap.setOwner( h, regionOwner );
+//				blockList.push_back( h );
+				*(blocks.createNew()) = h;
+				h->set( nullptr, nullptr, pagesPerAllocatedBlock, true );
+				addToFreeList( h );
+				++emptyBlockCnt;
+				fitting = ((uint64_t)1) << max_pages;
+			}
 
-				assert( freeListBegin[ max_pages ] != nullptr );
-				assert( freeListBegin[ max_pages ]->getPageCount() > max_pages );
-				assert( freeListBegin[ max_pages ]->prevFree == nullptr );
+			uint8_t idx = lowestBitIdx( fitting );
+			assert( idx >= pageCount - 1 && idx <= max_pages );
+			FreeChunkHeader* fit = freeListBegin[ idx ];
+			assert( fit != nullptr && fit->prevFree == nullptr );
+			assert( fit->getPageCount() >= pageCount );
+			removeFromFreeList( fit );
+			if ( fit->getPageCount() == pagesPerAllocatedBlock )
+			{
+				assert( emptyBlockCnt != 0 );
+				--emptyBlockCnt;
+			}
+			ret = fit;
 
-				ret = freeListBegin[ max_pages ];
-				freeListBegin[ max_pages ] = freeListBegin[ max_pages ]->nextFree; // pop
-				if ( freeListBegin[ max_pages ] != nullptr )
-					freeListBegin[ max_pages ]->prevFree = nullptr;
+			if ( ret->getPageCount() > pageCount )
+			{
 				FreeChunkHeader* updatedBegin = reinterpret_cast<FreeChunkHeader*>( reinterpret_cast<uint8_t*>(ret) + (pageCount << PAGE_SIZE_EXP) );
 				updatedBegin->set( ret, ret->nextInBlock(), ret->getPageCount() - (uint16_t)pageCount, true );
-				updatedBegin->prevFree = nullptr;
-				updatedBegin->nextFree = nullptr;
-
+				if ( updatedBegin->nextInBlock() )
+					updatedBegin->nextInBlock()->setPrevInBlock( updatedBegin );
+				addToFreeList( updatedBegin );
 				ret->set( ret->prevInBlock(), updatedBegin, (uint16_t)pageCount, false );
-				assert( freeListBegin[ max_pages ] != updatedBegin );
-
-				uint16_t remainingPageCnt = updatedBegin->getPageCount();
-				if ( remainingPageCnt > max_pages )
-				{
-					updatedBegin->nextFree = freeListBegin[ max_pages ];
-					if ( freeListBegin[ max_pages ] != nullptr )
-						freeListBegin[ max_pages ]->prevFree = updatedBegin;
-					freeListBegin[ max_pages ] = updatedBegin;
-				}
-				else
-				{
-					updatedBegin->nextFree = freeListBegin[ remainingPageCnt - 1 ];
-					if ( freeListBegin[ remainingPageCnt - 1 ] != nullptr )
-						freeListBegin[ remainingPageCnt - 1 ]->prevFree = updatedBegin;
-					freeListBegin[ remainingPageCnt - 1 ] = updatedBegin;
-				}
 			}
 			else
-			{
-				assert( freeListBegin[pageCount - 1]->nextFree == nullptr || freeListBegin[pageCount - 1]->nextFree->prevFree == freeListBegin[pageCount - 1] );
-				assert( freeListBegin[pageCount - 1]->prevFree == nullptr );
-				ret = freeListBegin[pageCount - 1];
-				freeListBegin[pageCount - 1] = freeListBegin[pageCount - 1]->nextFree;
-				if ( freeListBegin[pageCount - 1] != nullptr )
-					freeListBegin[pageCount - 1]->prevFree = nullptr;
-			}
+				ret->set( ret->prevInBlock(), ret->nextInBlock(), (uint16_t)pageCount, false );
 			assert( ret->getPageCount() <= max_pages );
 		}
 		else
 		{
-			ret = reinterpret_cast<FreeChunkHeader*>( this->getFreeBlockNoCache( pageCount << PAGE_SIZE_EXP ) );
-			ret->set( (FreeChunkHeader*)(void*)(pageCount<<PAGE_SIZE_EXP), nullptr, 0, false );
+			size_t sz = pageCount << PAGE_SIZE_EXP;
+			ret = reinterpret_cast<FreeChunkHeader*>( this->getLargeBlock( sz ) );
+			ret->set( (FreeChunkHeader*)(void*)(sz), nullptr, 0, false );
 			assert( ret->getPageCount() == 0 );
 		}
 
@@ -689,6 +969,54 @@ public:
 		return ret;
 	}
 
+	// returns a chunk of at least sz bytes starting at the first alignment boundary past its header page;
+	// alignment: power of 2, larger than page size
+	AnyChunkHeader* allocateAligned( size_t sz, size_t alignment )
+	{
+		assert( alignment > PAGE_SIZE && ( alignment & ( alignment - 1 ) ) == 0 );
+		size_t pageCount = 1 + ( alignUpExp( sz, PAGE_SIZE_EXP ) >> PAGE_SIZE_EXP );
+		size_t extraPages = ( alignment >> PAGE_SIZE_EXP ) - 1;
+
+		if ( pageCount + extraPages > max_pages )
+		{
+			// the header occupies an aligned block start; pages up to the next boundary are never touched
+			size_t fullSz = alignment + ( ( pageCount - 1 ) << PAGE_SIZE_EXP );
+			AnyChunkHeader* ret = reinterpret_cast<AnyChunkHeader*>( this->getFreeAlignedBlockNoCache( fullSz, sizeToExp( alignment ) ) );
+			ret->set( (AnyChunkHeader*)(void*)(fullSz), nullptr, 0, false );
+			return ret;
+		}
+
+		// take extra pages and give back the excess on both sides
+		AnyChunkHeader* h = allocate( ( pageCount + extraPages ) << PAGE_SIZE_EXP );
+		uint16_t totalPages = h->getPageCount();
+		AnyChunkHeader* ret = reinterpret_cast<AnyChunkHeader*>( alignUpMask( (uintptr_t)(h) + PAGE_SIZE, alignment - 1 ) - PAGE_SIZE );
+		uint16_t leadPages = (uint16_t)( ( (uintptr_t)(ret) - (uintptr_t)(h) ) >> PAGE_SIZE_EXP );
+		uint16_t tailPages = totalPages - leadPages - (uint16_t)pageCount;
+		AnyChunkHeader* prev = h->prevInBlock();
+		AnyChunkHeader* next = h->nextInBlock();
+		AnyChunkHeader* tail = reinterpret_cast<AnyChunkHeader*>( reinterpret_cast<uint8_t*>(ret) + ( pageCount << PAGE_SIZE_EXP ) );
+		if ( tailPages )
+		{
+			tail->set( ret, next, tailPages, false );
+			if ( next )
+				next->setPrevInBlock( tail );
+			next = tail;
+		}
+		else if ( next )
+			next->setPrevInBlock( ret );
+		if ( leadPages )
+		{
+			h->set( prev, ret, leadPages, false );
+			prev = h;
+		}
+		ret->set( prev, next, (uint16_t)pageCount, false );
+		if ( leadPages )
+			deallocate( h );
+		if ( tailPages )
+			deallocate( tail );
+		return ret;
+	}
+
 	void deallocate( void* ptr )
 	{
 		AnyChunkHeader* h = reinterpret_cast<AnyChunkHeader*>( ptr );
@@ -705,30 +1033,32 @@ public:
 			{
 				assert( prev->prevInBlock() == nullptr || !prev->prevInBlock()->isFree() );
 				assert( prev->nextInBlock() == h );
-				assert( reinterpret_cast<uint8_t*>(prev->prevInBlock()) + (prev->prevInBlock()->getPageCount() << PAGE_SIZE_EXP) == reinterpret_cast<uint8_t*>( h ) );
+				assert( reinterpret_cast<uint8_t*>(prev) + (prev->getPageCount() << PAGE_SIZE_EXP) == reinterpret_cast<uint8_t*>( h ) );
 				removeFromFreeList( reinterpret_cast<FreeChunkHeader*>(prev) );
 				prev->set( prev->prevInBlock(), h->nextInBlock(), prev->getPageCount() + h->getPageCount(), true );
 				h = prev;
 			}
+			else
+				h->set( h->prevInBlock(), h->nextInBlock(), h->getPageCount(), true );
 			AnyChunkHeader* next = h->nextInBlock();
 			if ( next && next->isFree() )
 			{
 				assert( next->nextInBlock() == nullptr || !next->nextInBlock()->isFree() );
-				assert( next->prevInBlock() == h );
 				assert( reinterpret_cast<uint8_t*>(h) + (h->getPageCount() << PAGE_SIZE_EXP) == reinterpret_cast<uint8_t*>( next ) );
 				removeFromFreeList( reinterpret_cast<FreeChunkHeader*>(next) );
 				h->set( h->prevInBlock(), next->nextInBlock(), h->getPageCount() + next->getPageCount(), true );
 			}
+			if ( h->nextInBlock() )
+				h->nextInBlock()->setPrevInBlock( h );
 
-			FreeChunkHeader* hfree = reinterpret_cast<FreeChunkHeader*>(h);
-			uint16_t idx = hfree->getPageCount() - 1;
-			if ( idx >= max_pages )
-				idx = max_pages;
-			hfree->prevFree = nullptr;
-			hfree->nextFree = freeListBegin[idx];
-			if ( freeListBegin[idx] != nullptr )
-				freeListBegin[idx]->prevFree = hfree;
-			freeListBegin[idx] = hfree;
+			if ( h->getPageCount() == pagesPerAllocatedBlock && emptyBlockCnt >= retained_empty_blocks )
+				releaseBlock( h );
+			else
+			{
+				if ( h->getPageCount() == pagesPerAllocatedBlock )
+					++emptyBlockCnt;
+				addToFreeList( reinterpret_cast<FreeChunkHeader*>(h) );
+			}
 
 #ifdef BULKALLOCATOR_HEAVY_DEBUG
 		dbgValidateAllBlocks();
@@ -738,16 +1068,90 @@ public:
 		else
 		{
 			size_t deallocSize = (size_t)(h->prevInBlock());
-			this->freeChunkNoCache( ptr, deallocSize );
+			if ( !this->freeLargeBlock( ptr, deallocSize ) && !g_PagePurger.addForUnmap( ptr, deallocSize ) )
+				this->freeChunkNoCache( ptr, deallocSize );
 		}
 
 	}
 
+	static size_t getChunkSize( const AnyChunkHeader* h )
+	{
+		if ( h->getPageCount() != 0 )
+			return ((size_t)(h->getPageCount())) << PAGE_SIZE_EXP;
+		return (size_t)(h->prevInBlock());
+	}
+
+	// resizes a chunk in place, absorbing the next free chunk of the block if necessary;
+	// chunks beyond max_pages are remapped and thus may move. Returns nullptr if nothing of that applies
+	AnyChunkHeader* reallocate( AnyChunkHeader* h, size_t szIncludingHeader )
+	{
+		size_t pageCount = alignUpExp( szIncludingHeader, PAGE_SIZE_EXP ) >> PAGE_SIZE_EXP;
+		if ( h->getPageCount() == 0 )
+		{
+			if ( pageCount <= max_pages )
+				return nullptr;
+			size_t oldSz = (size_t)(h->prevInBlock());
+			size_t newSz = pageCount << PAGE_SIZE_EXP;
+			if ( newSz == oldSz )
+				return h;
+			AnyChunkHeader* ret = reinterpret_cast<AnyChunkHeader*>( this->reallocateNoCache( h, oldSz, newSz ) );
+			if ( ret != nullptr )
+				ret->set( (AnyChunkHeader*)(void*)(newSz), nullptr, 0, false );
+			return ret;
+		}
+
+		if ( pageCount > max_pages )
+			return nullptr;
+#ifdef BULKALLOCATOR_HEAVY_DEBUG
+		dbgValidateAllBlocks();
+		dbgValidateAllFreeLists();
+#endif
+		uint16_t availablePages = h->getPageCount();
+		AnyChunkHeader* next = h->nextInBlock();
+		bool grown = pageCount > availablePages;
+		if ( grown )
+		{
+			if ( next == nullptr || !next->isFree() || availablePages + next->getPageCount() < pageCount )
+				return nullptr;
+			removeFromFreeList( reinterpret_cast<FreeChunkHeader*>(next) );
+			availablePages += next->getPageCount();
+			next = next->nextInBlock();
+		}
+
+		// whatever remains past the new end goes back to free lists
+		if ( availablePages > pageCount )
+		{
+			AnyChunkHeader* rest = reinterpret_cast<AnyChunkHeader*>( reinterpret_cast<uint8_t*>(h) + ( pageCount << PAGE_SIZE_EXP ) );
+			if ( next )
+				next->setPrevInBlock( rest );
+			h->set( h->prevInBlock(), rest, (uint16_t)pageCount, false );
+			if ( grown )
+			{
+				// neighbors of the former free chunk are not free; the rest may exceed max_pages though
+				rest->set( h, next, availablePages - (uint16_t)pageCount, true );
+				addToFreeList( reinterpret_cast<FreeChunkHeader*>(rest) );
+			}
+			else
+			{
+				rest->set( h, next, availablePages - (uint16_t)pageCount, false );
+				deallocate( rest );
+			}
+		}
+		else
+		{
+			if ( next )
+				next->setPrevInBlock( h );
+			h->set( h->prevInBlock(), next, (uint16_t)pageCount, false );
+		}
+		return h;
+	}
+
 	void deinitialize()
 	{
-		class F { private: BasePageAllocator* alloc; public: F(BasePageAllocator*alloc_) {alloc = alloc_;} void f(AnyChunkHeader* h) {assert( h != nullptr ); alloc->freeChunkNoCache( h, commited_block_size ); } }; F f(this);
+		class F { private: BasePageAllocator* alloc; public: F(BasePageAllocator*alloc_) {alloc = alloc_;} void f(AnyChunkHeader* h) {assert( h != nullptr ); g_RegionOwnerMap.setOwner( h, nullptr ); alloc->freeChunkNoCache( h, commited_block_size ); } }; F f(this);
 		blocks.doForEach(f);
 		blocks.deinitialize();
+		this->flushLargeBlocks();
 /*		for ( size_t i=0; i<blockList.size(); ++i )
 		{
 			assert( blockList[i] != nullptr );
@@ -756,6 +1160,8 @@ public:
 		blockList.clear();*/
 		for ( size_t i=0; i<=max_pages; ++i )
 			freeListBegin[i] = nullptr;
+		nonEmptyFreeLists = 0;
+		emptyBlockCnt = 0;
 #ifdef BULKALLOCATOR_HEAVY_DEBUG
 		dbgValidateAllBlocks();
 		dbgValidateAllFreeLists();
@@ -763,17 +1169,47 @@ public:
 	}
 };
 
-//#define USE_EXP_BUCKET_SIZES
-#define USE_HALF_EXP_BUCKET_SIZES
-//#define USE_QUAD_EXP_BUCKET_SIZES
+// Items of a heap deallocated by other threads (an intrusive lock-free MPSC stack);
+// the owner takes it as a whole and processes it on its slow paths.
+// Heaps register themselves in g_RegionOwnerMap as this base, so that heaps of different configurations can exchange items
+class RemoteFreeList
+{
+protected:
+	ALIGN(64) std::atomic<void*> remoteFreeList;
 
-class SerializableAllocatorBase
+public:
+	void pushRemoteFree( void* ptr )
+	{
+		void* head = remoteFreeList.load( std::memory_order_relaxed );
+		do
+			*reinterpret_cast<void**>( ptr ) = head;
+		while ( !remoteFreeList.compare_exchange_weak( head, ptr, std::memory_order_release, std::memory_order_relaxed ) );
+	}
+};
+
+// BucketSizesT: a scheme of bucket sizes (see bucket_sizes.h)
+// max_bucket_size: the largest size served from buckets; larger ones go to the bulk allocator
+// bucket_count_exp: log2 of the number of buckets (the last one is reserved for span counters of the page allocator)
+// reservation_size_exp: log2 of the size of address space reserved at once for buckets; a multiple of RegionOwnerMap::region_size
+// lazy_formatting: a span taken by a bucket is not threaded into its free list right away; instead, its items are handed out
+//                  one by one from a bump pointer, and only deallocated items go to the free list (thus, only pages actually
+//                  used are touched)
+template<class BucketSizesT, size_t max_bucket_size, size_t bucket_count_exp, size_t reservation_size_exp, bool lazy_formatting = false>
+class SerializableAllocator : public RemoteFreeList
 {
+	static_assert( ( max_bucket_size & ( max_bucket_size - 1 ) ) == 0, "max_bucket_size is expected to be a power of 2" );
+	static_assert( max_bucket_size >= PAGE_SIZE, "revise implementation" );
+
 protected:
-	static constexpr size_t MaxBucketSize = PAGE_SIZE * 2;
-	static constexpr size_t BucketCountExp = 6;
+	static constexpr size_t MaxBucketSize = max_bucket_size;
+	static constexpr size_t BucketCountExp = bucket_count_exp;
 	static constexpr size_t BucketCount = 1 << BucketCountExp;
 	void* buckets[BucketCount];
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+	// lazy_formatting only: not yet used items of the last span of each bucket (none, if spanNext[idx] == spanEnd[idx])
+	uint8_t* spanNext[BucketCount];
+	uint8_t* spanEnd[BucketCount];
+#endif
 
 	struct ChunkHeader
 	{
@@ -782,8 +1218,7 @@ protected:
 		size_t idx;
 	};
 	
-	static constexpr size_t reservation_size_exp = 23;
-	typedef BulkAllocator<PageAllocatorWithCaching, 1 << reservation_size_exp, 32> BulkAllocatorT;
+	typedef BulkAllocator<PageAllocatorWithCaching, RegionOwnerMap::region_size, 32> BulkAllocatorT;
 	BulkAllocatorT bulkAllocator;
 
 #ifdef USE_SOUNDING_PAGE_ADDRESS
@@ -814,166 +1249,12 @@ protected:
 
 protected:
 public:
-#ifdef USE_EXP_BUCKET_SIZES
-	static constexpr
-	FORCE_INLINE size_t indexToBucketSize(uint8_t ix) // Note: currently is used once per page formatting
-	{
-		return 1ULL << (ix + 3);
-	}
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-	static constexpr
-	FORCE_INLINE size_t indexToBucketSizeHalfExp(uint8_t ix) // Note: currently is used once per page formatting
-	{
-		size_t ret = ( 1ULL << ((ix>>1) + 3) ) + ( ( ( ( ix + 1 ) & 1 ) - 1 ) & ( 1ULL << ((ix>>1) + 2) ) );
-		return alignUpExp( ret, 3 ); // this is because of case ix = 1, ret = 12 (keeping 8-byte alignment)
-	}
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-	static constexpr
-	FORCE_INLINE size_t indexToBucketSizeQuarterExp(uint8_t ix) // Note: currently is used once per page formatting
-	{
-		ix += 3;
-		size_t ret = ( 4ULL << ((ix>>2)) ) + ((ix&3)+1) * (1ULL << ((ix>>2)));
-//		size_t ret = ( 4ULL << ((ix>>2)) ) + ( ( ( ( ix+1) & 1 ) - 1 ) & (1ULL << ((ix>>2))) ) + ( ( ( ((ix>>1)+1) & 1 ) - 1 ) & (2ULL << ((ix>>2))) ) + (1ULL << ((ix>>2)));
-		return alignUpExp( ret, 3 ); // this is because of case ix = 1, ret = 12 (keeping 8-byte alignment), etc
-	}
-#else
-#error "Undefined bucket size schema"
-#endif
-
-#if defined(_MSC_VER)
-#if defined(_M_IX86)
-#ifdef USE_EXP_BUCKET_SIZES
-	static
-		FORCE_INLINE uint8_t sizeToIndex(uint32_t sz)
-	{
-		unsigned long ix;
-		uint8_t r = _BitScanReverse(&ix, sz - 1);
-		return (sz <= 8) ? 0 : static_cast<uint8_t>(ix - 2);
-	}
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-#error "not implemented"
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-#error "not implemented"
-#else
-#error "Undefined bucket size schema
-#endif
-#elif defined(_M_X64)
-#ifdef USE_EXP_BUCKET_SIZES
-	static
-	FORCE_INLINE uint8_t sizeToIndex(uint64_t sz)
-	{
-		unsigned long ix;
-		uint8_t r = _BitScanReverse64(&ix, sz - 1);
-		return (sz <= 8) ? 0 : static_cast<uint8_t>(ix - 2);
-	}
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-	static
-	FORCE_INLINE uint8_t sizeToIndexHalfExp(uint64_t sz)
-	{
-		if ( sz <= 8 )
-			return 0;
-		sz -= 1;
-		unsigned long ix;
-		uint8_t r = _BitScanReverse64(&ix, sz);
-//		printf( "ix = %zd\n", ix );
-		uint8_t addition = 1 & ( sz >> (ix-1) );
-		ix = ((ix-2)<<1) + addition - 1;
-		return static_cast<uint8_t>(ix);
-	}
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-	static
-	FORCE_INLINE uint8_t sizeToIndexQuarterExp(uint64_t sz)
-	{
-		if ( sz <= 8 )
-			return 0;
-		sz -= 1;
-		unsigned long ix;
-		uint8_t r = _BitScanReverse64(&ix, sz);
-//		printf( "ix = %zd\n", ix );
-		uint8_t addition = 3 & ( sz >> (ix-2) );
-		ix = ((ix-2)<<2) + addition - 3;
-		return static_cast<uint8_t>(ix);
-	}
-#else
-#error "Undefined bucket size schema
-#endif
-#else
-#error Unknown 32/64 bits architecture
-#endif
-
-#elif defined(__GNUC__)
-#if defined(__i386__)
-#ifdef USE_EXP_BUCKET_SIZES
-	static
-		FORCE_INLINE uint8_t sizeToIndex(uint32_t sz)
-	{
-		uint32_t ix = __builtin_clzl(sz - 1);
-		return (sz <= 8) ? 0 : static_cast<uint8_t>(29ul - ix);
-	}
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-#error "not implemented"
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-#error "not implemented"
-#else
-#error "Undefined bucket size schema
-#endif
-#elif defined(__x86_64__)
-#ifdef USE_EXP_BUCKET_SIZES
-	static
-		FORCE_INLINE uint8_t sizeToIndex(uint64_t sz)
-	{
-		uint64_t ix = __builtin_clzll(sz - 1);
-		return (sz <= 8) ? 0 : static_cast<uint8_t>(61ull - ix);
-	}
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-	static
-		FORCE_INLINE uint8_t sizeToIndexHalfExp(uint64_t sz)
-	{
-		if ( sz <= 8 )
-			return 0;
-		sz -= 1;
-//		uint64_t ix = __builtin_clzll(sz - 1);
-//		return (sz <= 8) ? 0 : static_cast<uint8_t>(61ull - ix);
-		uint64_t ix = __builtin_clzll(sz);
-		ix = 63ull - ix;
-//		printf( "ix = %zd\n", ix );
-		uint8_t addition = 1ull & ( sz >> (ix-1) );
-		ix = ((ix-2)<<1) + addition - 1;
-		return static_cast<uint8_t>(ix);
-	}
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-	static
-		FORCE_INLINE uint8_t sizeToIndexQuarterExp(uint64_t sz)
-	{
-		if ( sz <= 8 )
-			return 0;
-		sz -= 1;
-//		uint64_t ix = __builtin_clzll(sz - 1);
-//		return (sz <= 8) ? 0 : static_cast<uint8_t>(61ull - ix);
-		uint64_t ix = __builtin_clzll(sz);
-		ix = 63ull - ix;
-//		printf( "ix = %zd\n", ix );
-		uint8_t addition = 3ull & ( sz >> (ix-2) );
-		ix = ((ix-2)<<2) + addition - 3;
-		return static_cast<uint8_t>(ix);
-	}
-#else
-#error "Undefined bucket size schema
-#endif
-#else
-#error Unknown 32/64 bits architecture
-#endif	
-
-#else
-#error Unknown compiler
-#endif
-	
 public:
-	SerializableAllocatorBase() { initialize(); }
-	SerializableAllocatorBase(const SerializableAllocatorBase&) = delete;
-	SerializableAllocatorBase(SerializableAllocatorBase&&) = default;
-	SerializableAllocatorBase& operator=(const SerializableAllocatorBase&) = delete;
-	SerializableAllocatorBase& operator=(SerializableAllocatorBase&&) = default;
+	SerializableAllocator() { initialize(); }
+	SerializableAllocator(const SerializableAllocator&) = delete;
+	SerializableAllocator(SerializableAllocator&&) = default;
+	SerializableAllocator& operator=(const SerializableAllocator&) = delete;
+	SerializableAllocator& operator=(SerializableAllocator&&) = default;
 
 	void enable() {}
 	void disable() {}
@@ -1028,30 +1309,79 @@ public:
 		}
 	}
 
-	NOINLINE void* allocateInCaseNoFreeBucket( size_t sz, uint8_t szidx )
+	FORCE_INLINE void* popFromBucket( uint8_t szidx )
 	{
-#ifdef USE_EXP_BUCKET_SIZES
-		size_t bucketSz = indexToBucketSize( szidx );
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-		size_t bucketSz = indexToBucketSizeHalfExp( szidx );
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-		size_t bucketSz = indexToBucketSizeQuarterExp( szidx );
-#else
-#error "Undefined bucket size schema
+		void* ret = buckets[szidx];
+		buckets[szidx] = *reinterpret_cast<void**>(buckets[szidx]);
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+		pageAllocator.registerAllocated( ret, szidx );
 #endif
+		return ret;
+	}
+
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+	FORCE_INLINE void* popFromSpan( uint8_t szidx, size_t bucketSz )
+	{
+		// items are skipped at the same offset as by formatAllocatedPageAlignedBlock()
+		constexpr size_t memForbidden = alignUpExp( BulkAllocatorT::reservedSizeAtPageStart(), ALIGNMENT_EXP );
+		assert( spanNext[szidx] != spanEnd[szidx] );
+		uint8_t* ret = spanNext[szidx];
+		uint8_t* next = ret + bucketSz;
+		if ( ( ((uintptr_t)next) & PAGE_SIZE_MASK ) == memForbidden )
+			next += bucketSz;
+		spanNext[szidx] = next + bucketSz <= spanEnd[szidx] ? next : spanEnd[szidx];
+		pageAllocator.registerAllocated( ret, szidx );
+		return ret;
+	}
+#endif
+
+	NOINLINE void drainRemoteFrees()
+	{
+		void* item = remoteFreeList.exchange( nullptr, std::memory_order_acquire );
+		while ( item )
+		{
+			void* next = *reinterpret_cast<void**>( item );
+			deallocateOwned( item, g_RegionOwnerMap.getOwner( item ) );
+			item = next;
+		}
+	}
+
+	NOINLINE void* allocateInCaseNoFreeBucket( size_t sz, uint8_t szidx )
+	{
+		if ( remoteFreeList.load( std::memory_order_relaxed ) != nullptr )
+		{
+			drainRemoteFrees();
+			if ( buckets[szidx] )
+				return popFromBucket( szidx );
+		}
+		size_t bucketSz = BucketSizesT::indexToBucketSize( szidx );
 		assert( bucketSz >= sizeof( void* ) );
 #ifdef USE_SOUNDING_PAGE_ADDRESS
 #else
 #endif
 #ifdef USE_SOUNDING_PAGE_ADDRESS
-		PageAllocatorT::MultipageData mpData;
+		if constexpr ( lazy_formatting )
+		{
+			if ( spanNext[szidx] != spanEnd[szidx] )
+				return popFromSpan( szidx, bucketSz );
+		}
+		buckets[szidx] = pageAllocator.takePartialSpan( szidx );
+		if ( buckets[szidx] )
+			return popFromBucket( szidx );
+		typename PageAllocatorT::MultipageData mpData;
 //		uint8_t* block = reinterpret_cast<uint8_t*>( pageAllocator.getPage( szidx ) );
 		pageAllocator.getMultipage( szidx, mpData );
+		if constexpr ( lazy_formatting )
+		{
+			assert( mpData.ptr2 == nullptr );
+			assert( mpData.sz1 >= bucketSz );
+			spanNext[szidx] = reinterpret_cast<uint8_t*>( mpData.ptr1 );
+			spanEnd[szidx] = spanNext[szidx] + mpData.sz1;
+			return popFromSpan( szidx, bucketSz );
+		}
 		formatAllocatedPageAlignedBlock( reinterpret_cast<uint8_t*>( mpData.ptr1 ), mpData.sz1, bucketSz, szidx );
 		formatAllocatedPageAlignedBlock( reinterpret_cast<uint8_t*>( mpData.ptr2 ), mpData.sz2, bucketSz, szidx );
-		void* ret = buckets[szidx];
-		buckets[szidx] = *reinterpret_cast<void**>(buckets[szidx]);
-		return ret;
+		return popFromBucket( szidx );
 #else
 		constexpr size_t memStart = 0;
 		uint8_t* block = reinterpret_cast<uint8_t*>( pageAllocator.getFreeBlock( PAGE_SIZE ) );
@@ -1081,6 +1411,8 @@ public:
 
 	NOINLINE void* allocateInCaseTooLargeForBucket(size_t sz)
 	{
+		if ( remoteFreeList.load( std::memory_order_relaxed ) != nullptr )
+			drainRemoteFrees();
 #ifdef USE_ITEM_HEADER
 		constexpr size_t memStart = alignUpExp( sizeof( ChunkHeader ) + sizeof( ItemHeader ), ALIGNMENT_EXP );
 #elif defined USE_SOUNDING_PAGE_ADDRESS
@@ -1112,20 +1444,11 @@ public:
 	{
 		if ( sz <= MaxBucketSize )
 		{
-#ifdef USE_EXP_BUCKET_SIZES
-			uint8_t szidx = sizeToIndex( sz );
-#elif defined USE_HALF_EXP_BUCKET_SIZES
-			uint8_t szidx = sizeToIndexHalfExp( sz );
-#elif defined USE_QUAD_EXP_BUCKET_SIZES
-			uint8_t szidx = sizeToIndexQuarterExp( sz );
-#else
-#error "Undefined bucket size schema
-#endif
+			uint8_t szidx = BucketSizesT::sizeToIndex( sz );
 			assert( szidx < BucketCount );
 			if ( buckets[szidx] )
 			{
-				void* ret = buckets[szidx];
-				buckets[szidx] = *reinterpret_cast<void**>(buckets[szidx]);
+				void* ret = popFromBucket( szidx );
 #ifdef USE_ITEM_HEADER
 				reinterpret_cast<ItemHeader*>( ret )->idx = szidx;
 				return reinterpret_cast<uint8_t*>(ret) + sizeof( ItemHeader );
@@ -1142,6 +1465,138 @@ public:
 		return nullptr;
 	}
 
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+	NOINLINE void* allocateAlignedInCaseTooLargeForBucket( size_t sz, size_t alignment )
+	{
+		if ( remoteFreeList.load( std::memory_order_relaxed ) != nullptr )
+			drainRemoteFrees();
+		// the chunk start is recorded right before the returned pointer; its offset in page never equals that of regular chunks
+		constexpr size_t memStart = alignUpExp( BulkAllocatorT::reservedSizeAtPageStart() + sizeof( void* ), ALIGNMENT_EXP );
+		static_assert( memStart <= 2 * ALIGNMENT, "" );
+		uint8_t* block;
+		if ( alignment <= PAGE_SIZE )
+			block = reinterpret_cast<uint8_t*>( bulkAllocator.allocate( sz + alignment ) );
+		else
+			block = reinterpret_cast<uint8_t*>( bulkAllocator.allocateAligned( sz, alignment ) );
+		uint8_t* ret = reinterpret_cast<uint8_t*>( alignUpMask( (uintptr_t)(block) + memStart, alignment - 1 ) );
+		reinterpret_cast<void**>( ret )[-1] = block;
+		return ret;
+	}
+
+	// alignment: power of 2
+	FORCE_INLINE void* allocateAligned( size_t sz, size_t alignment )
+	{
+		assert( alignment != 0 && ( alignment & ( alignment - 1 ) ) == 0 );
+		if ( sz <= MaxBucketSize && alignment <= MaxBucketSize )
+		{
+			// bucket spans are aligned to their size, so an item is aligned as the lowest set bit of the bucket size
+			// (which, for some buckets, is below ALIGNMENT, say, 8 and 24 with HalfExpBucketSizes)
+			size_t alignedSz = sz < alignment ? alignment : sz;
+			uint8_t szidx = BucketSizesT::sizeToIndex( alignedSz );
+			while ( BucketSizesT::indexToBucketSize( szidx ) & ( alignment - 1 ) )
+				++szidx;
+			assert( szidx < BucketCount );
+			if ( buckets[szidx] )
+				return popFromBucket( szidx );
+			else
+				return allocateInCaseNoFreeBucket( alignedSz, szidx );
+		}
+		else if ( alignment <= ALIGNMENT ) // large chunks are aligned anyway
+			return allocate( sz );
+		else
+			return allocateAlignedInCaseTooLargeForBucket( sz, alignment );
+	}
+
+	// the number of bytes usable at ptr, which may be more than requested
+	size_t getAllocatedSize( void* ptr ) const
+	{
+		void* owner = g_RegionOwnerMap.getOwner( ptr );
+		if ( owner != nullptr && ( (uintptr_t)(owner) & 1 ) == 0 )
+		{
+			size_t idx = PageAllocatorT::addressToIdx( ptr );
+			return BucketSizesT::indexToBucketSize( idx );
+		}
+		const BulkAllocatorT::AnyChunkHeader* h = reinterpret_cast<const BulkAllocatorT::AnyChunkHeader*>( bulkChunkFromUsrPtr( ptr ) );
+		return BulkAllocatorT::getChunkSize( h ) - ( reinterpret_cast<uint8_t*>( ptr ) - reinterpret_cast<const uint8_t*>( h ) );
+	}
+
+	void* reallocate( void* ptr, size_t sz )
+	{
+		if ( ptr == nullptr )
+			return allocate( sz );
+		if ( sz == 0 )
+		{
+			deallocate( ptr );
+			return nullptr;
+		}
+
+		void* owner = g_RegionOwnerMap.getOwner( ptr );
+		if ( owner != nullptr && ( (uintptr_t)(owner) & 1 ) == 0 )
+		{
+			// a bucket item stays as long as the size class does not change
+			size_t idx = PageAllocatorT::addressToIdx( ptr );
+			if ( sz <= MaxBucketSize && BucketSizesT::sizeToIndex( sz ) == idx )
+				return ptr;
+		}
+		else if ( sz > MaxBucketSize )
+		{
+			typedef BulkAllocatorT::AnyChunkHeader AnyChunkHeader;
+			constexpr size_t memStart = alignUpExp( BulkAllocatorT::reservedSizeAtPageStart(), ALIGNMENT_EXP );
+			AnyChunkHeader* h = reinterpret_cast<AnyChunkHeader*>( bulkChunkFromUsrPtr( ptr ) );
+			size_t offset = reinterpret_cast<uint8_t*>( ptr ) - reinterpret_cast<uint8_t*>( h );
+			// chunks of other heaps are not touched; large chunks may move, so only unaligned ones are remapped
+			if ( owner == bulkRegionOwner() || ( owner == nullptr && offset == memStart ) )
+			{
+				AnyChunkHeader* resized = bulkAllocator.reallocate( h, sz + offset );
+				if ( resized != nullptr )
+					return reinterpret_cast<uint8_t*>( resized ) + offset;
+			}
+		}
+
+		size_t oldSz = getAllocatedSize( ptr );
+		void* ret = allocate( sz );
+		memcpy( ret, ptr, oldSz < sz ? oldSz : sz );
+		deallocate( ptr );
+		return ret;
+	}
+#endif // USE_SOUNDING_PAGE_ADDRESS
+
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+	// bucket reservations are registered with the heap as RemoteFreeList, and bulk blocks with the same address
+	// tagged by its lowest bit to tell them from bucket reservations when deallocating
+	void* heapRegionOwner() { return static_cast<RemoteFreeList*>( this ); }
+	void* bulkRegionOwner() { return reinterpret_cast<uint8_t*>( heapRegionOwner() ) + 1; }
+
+	static FORCE_INLINE void* bulkChunkFromUsrPtr( void* ptr )
+	{
+		constexpr size_t memStart = alignUpExp( BulkAllocatorT::reservedSizeAtPageStart(), ALIGNMENT_EXP );
+		if ( PageAllocatorT::getOffsetInPage( ptr ) == memStart )
+			return PageAllocatorT::ptrToPageStart( ptr );
+		return reinterpret_cast<void**>( ptr )[-1]; // see allocateAlignedInCaseTooLargeForBucket()
+	}
+
+	FORCE_INLINE void deallocateOwned( void* ptr, void* owner )
+	{
+		if ( owner == heapRegionOwner() )
+		{
+			size_t idx = PageAllocatorT::addressToIdx( ptr );
+			if ( pageAllocator.isCurrentSpan( ptr, idx ) )
+			{
+				*reinterpret_cast<void**>( ptr ) = buckets[idx];
+				buckets[idx] = ptr;
+				pageAllocator.registerDeallocated( ptr, idx );
+			}
+			else
+				pageAllocator.deallocateToSpan( ptr, idx );
+		}
+		else
+		{
+			assert( owner == bulkRegionOwner() );
+			bulkAllocator.deallocate( bulkChunkFromUsrPtr( ptr ) );
+		}
+	}
+#endif // USE_SOUNDING_PAGE_ADDRESS
+
 	FORCE_INLINE void deallocate(void* ptr)
 	{
 		if(ptr)
@@ -1161,25 +1616,16 @@ public:
 				pageAllocator.freeChunk( reinterpret_cast<MemoryBlockListItem*>(ch) );
 			}
 #elif defined USE_SOUNDING_PAGE_ADDRESS
-			size_t offsetInPage = PageAllocatorT::getOffsetInPage( ptr );
-//			if ( offsetInPage != alignUpExp( sizeof( size_t ), ALIGNMENT_EXP ) )
-			constexpr size_t memForbidden = alignUpExp( BulkAllocatorT::reservedSizeAtPageStart(), ALIGNMENT_EXP );
-			if ( offsetInPage != memForbidden )
-			{
-				size_t idx = PageAllocatorT::addressToIdx( ptr );
-				*reinterpret_cast<void**>( ptr ) = buckets[idx];
-				buckets[idx] = ptr;
-			}
+			void* owner = g_RegionOwnerMap.getOwner( ptr );
+			uintptr_t ownerHeap = (uintptr_t)(owner) & ~(uintptr_t)(1);
+			if ( ownerHeap == (uintptr_t)(heapRegionOwner()) )
+				deallocateOwned( ptr, owner );
+			else if ( owner != nullptr )
+				reinterpret_cast<RemoteFreeList*>( ownerHeap )->pushRemoteFree( ptr );
 			else
 			{
-				void* pageStart = PageAllocatorT::ptrToPageStart( ptr );
-/*				MemoryBlockListItem* h = reinterpret_cast<MemoryBlockListItem*>(pageStart);
-				h->size = *reinterpret_cast<size_t*>(pageStart);
-				h->sizeIndex = 0xFFFFFFFF; // TODO: address properly!!!
-				h->prev = nullptr;
-				h->next = nullptr;
-				pageAllocator.freeChunk( reinterpret_cast<MemoryBlockListItem*>(h) );*/
-				bulkAllocator.deallocate( pageStart );
+				// large chunks are not within any registered region; they can be unmapped by any thread
+				bulkAllocator.deallocate( bulkChunkFromUsrPtr( ptr ) );
 			}
 #else
 			ChunkHeader* h = getChunkFromUsrPtr( ptr );
@@ -1199,6 +1645,19 @@ public:
 	void printStats()
 	{
 		pageAllocator.printStats();
+		bulkAllocator.printStats();
+	}
+
+	// hands freed large chunks kept for reuse over to g_CentralBlockPool (those it does not take are unmapped)
+	void releaseCachedBlocks()
+	{
+		bulkAllocator.flushLargeBlocks();
+	}
+
+	// unmaps large chunks pooled by all threads
+	void releasePooledBlocks()
+	{
+		bulkAllocator.releasePooledBlocks();
 	}
 
 	void initialize(size_t size)
@@ -1208,9 +1667,27 @@ public:
 
 	void initialize()
 	{
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+		// the last bucket holds span counters of the page allocator
+		static_assert( BucketSizesT::indexToBucketSize( BucketCount - 1 ) > MaxBucketSize, "" );
+#endif // USE_SOUNDING_PAGE_ADDRESS
 		memset( buckets, 0, sizeof( void* ) * BucketCount );
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+		memset( spanNext, 0, sizeof( spanNext ) );
+		memset( spanEnd, 0, sizeof( spanEnd ) );
+#endif
+		remoteFreeList.store( nullptr, std::memory_order_relaxed );
 		pageAllocator.initialize( PAGE_SIZE_EXP );
 		bulkAllocator.initialize( PAGE_SIZE_EXP );
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+		pageAllocator.setRegionOwner( heapRegionOwner() );
+		pageAllocator.setHugePages( g_UseHugePages.load( std::memory_order_relaxed ) );
+#endif
+#ifdef USE_SOUNDING_PAGE_ADDRESS
+		bulkAllocator.setRegionOwner( bulkRegionOwner() );
+#else
+		bulkAllocator.setRegionOwner( this );
+#endif
 	}
 
 	void deinitialize()
@@ -1229,10 +1706,132 @@ public:
 		bulkAllocator.deinitialize();
 	}
 
-	~SerializableAllocatorBase()
+	~SerializableAllocator()
 	{
 		deinitialize();
 	}
 };
 
+typedef SerializableAllocator<HalfExpBucketSizes, PAGE_SIZE * 2, 6, 23> SerializableAllocatorBase;
+
+// Heaps of exited threads, to be adopted by threads started later. A heap here is never destroyed: objects
+// allocated by an exited thread stay valid, frees of them from other threads are taken by the parked heap as
+// remote ones, and a thread adopting it reuses its reservations and pages instead of mapping fresh ones.
+// Heaps are placed in memory of their own, as it is by their addresses that g_RegionOwnerMap refers to them.
+// Zero-initialized is empty, as heaps may be needed before static initialization is over.
+template<class HeapT>
+class ParkedHeapList
+{
+	struct Slot
+	{
+		HeapT heap; // first, for a heap pointer to be that of its slot
+		Slot* nextParked;
+	};
+
+	std::mutex mx;
+	Slot* parked = nullptr;
+
+public:
+	// a parked heap if any, or a new one
+	HeapT* adopt()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mx );
+			if ( parked != nullptr )
+			{
+				Slot* slot = parked;
+				parked = slot->nextParked;
+				return &(slot->heap);
+			}
+		}
+		// a heap itself is not allocated with any heap
+		void* mem = VirtualMemory::allocate( alignUpExp( sizeof( Slot ), PAGE_SIZE_EXP ) );
+		return &((new(mem) Slot)->heap);
+	}
+
+	// heap is to be one returned by adopt(), and not used by the caller any longer
+	void park( HeapT* heap )
+	{
+		heap->releaseCachedBlocks(); // a parked heap may stay unused for long
+		Slot* slot = reinterpret_cast<Slot*>( heap );
+		std::lock_guard<std::mutex> lock( mx );
+		slot->nextParked = parked;
+		parked = slot;
+	}
+
+	// around fork(), for the list to be consistent in a child
+	void lock() { mx.lock(); }
+	void unlock() { mx.unlock(); }
+};
+
+// Thread-local handle of a heap adopted from a ParkedHeapList on the first call of a thread (or initialize())
+// and parked back at thread exit (or deinitialize()), rather than a heap of its own to be unmapped at thread exit.
+// It is meant for services where threads come and go all the time, like ones with thread pools resized on demand;
+// each call costs an extra indirection.
+template<class HeapT>
+class AdoptingThreadHeap
+{
+	static ParkedHeapList<HeapT> parkedHeaps;
+	HeapT* heap = nullptr;
+
+	NOINLINE HeapT* attach()
+	{
+		heap = parkedHeaps.adopt();
+		return heap;
+	}
+
+	// calls may come after deinitialize(), from destructors of other thread_local objects, say; a heap attached
+	// after this one is destroyed is not parked any longer, it is just not reused
+	FORCE_INLINE HeapT* get()
+	{
+		HeapT* ret = heap;
+		if ( ret != nullptr )
+			return ret;
+		return attach();
+	}
+
+public:
+	AdoptingThreadHeap() {}
+	AdoptingThreadHeap(const AdoptingThreadHeap&) = delete;
+	AdoptingThreadHeap& operator=(const AdoptingThreadHeap&) = delete;
+	~AdoptingThreadHeap() { deinitialize(); }
+
+	void enable() {}
+	void disable() {}
+
+	void initialize(size_t size) { get(); }
+	void initialize() { get(); }
+
+	// live objects of the heap stay valid
+	void deinitialize()
+	{
+		if ( heap != nullptr )
+		{
+			parkedHeaps.park( heap );
+			heap = nullptr;
+		}
+	}
+
+	FORCE_INLINE void* allocate(size_t sz) { return get()->allocate( sz ); }
+	FORCE_INLINE void* allocateAligned( size_t sz, size_t alignment ) { return get()->allocateAligned( sz, alignment ); }
+	FORCE_INLINE void deallocate(void* ptr) { get()->deallocate( ptr ); }
+
+	const BlockStats& getStats() { return get()->getStats(); }
+	void printStats() { get()->printStats(); }
+	void releaseCachedBlocks() { get()->releaseCachedBlocks(); }
+	void releasePooledBlocks() { get()->releasePooledBlocks(); }
+};
+
+template<class HeapT>
+ParkedHeapList<HeapT> AdoptingThreadHeap<HeapT>::parkedHeaps;
+
+// with IIBMALLOC_ADOPT_ORPHANED_HEAPS, heaps of exited threads are parked and adopted by threads started later
+// (see AdoptingThreadHeap) instead of being unmapped along with objects still in use by other threads
+#ifdef IIBMALLOC_ADOPT_ORPHANED_HEAPS
+typedef AdoptingThreadHeap<SerializableAllocatorBase> AllocManagerT;
+#else
+typedef SerializableAllocatorBase AllocManagerT;
+#endif
+extern thread_local AllocManagerT g_AllocManager;
+
 #endif // IIBMALLOC_H
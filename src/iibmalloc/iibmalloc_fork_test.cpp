@@ -0,0 +1,117 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * iibmalloc allocator -- fork() test of the preloaded library
+ * 
+ * Usage: LD_PRELOAD=libiibmalloc.so [IIBMALLOC_DECOMMIT_DECAY_MS=...] [IIBMALLOC_UNMAP_DECAY_MS=...] iibmalloc_fork_test
+ * (see build_iibmalloc_fork_test_gcc.sh). Threads keep allocating and deallocating while the main thread forks;
+ * each child allocates, deallocates and exits normally (that is, with destructors of static objects run).
+ * A child that does not exit within child_timeout_s (a lock or a purger thread of the parent waited for)
+ * is killed with SIGALRM, and the test fails.
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static constexpr size_t thread_count = 3;
+static constexpr size_t fork_count = 200;
+static constexpr unsigned child_timeout_s = 10;
+
+static std::atomic<bool> stopRequested( false );
+
+// small items and large chunks, for bucket, bulk and large block cache locks to be taken as well
+static void allocateAndDeallocate( size_t seed, size_t count )
+{
+	void* ptrs[16];
+	for ( size_t i=0; i<count; ++i )
+	{
+		for ( size_t j=0; j<16; ++j )
+		{
+			size_t sz = ( ( seed + i * 16 + j ) & 1 ) ? 16 + j * 40 : 200000 + j * 70000;
+			ptrs[j] = malloc( sz );
+			if ( ptrs[j] == nullptr )
+				abort();
+			memset( ptrs[j], (int)j, sz < 64 ? sz : 64 );
+		}
+		for ( size_t j=0; j<16; ++j )
+			free( ptrs[j] );
+	}
+}
+
+int main()
+{
+	std::thread threads[thread_count];
+	for ( size_t i=0; i<thread_count; ++i )
+		threads[i] = std::thread( [i]() {
+			while ( !stopRequested.load( std::memory_order_relaxed ) )
+				allocateAndDeallocate( i, 64 );
+		} );
+
+	size_t failed = 0;
+	for ( size_t i=0; i<fork_count && failed == 0; ++i )
+	{
+		pid_t pid = fork();
+		if ( pid == -1 )
+		{
+			printf( "fork() failed\n" );
+			failed = 1;
+			break;
+		}
+		if ( pid == 0 )
+		{
+			alarm( child_timeout_s );
+			allocateAndDeallocate( i, 16 );
+			std::thread t( [i]() { allocateAndDeallocate( i, 16 ); } );
+			t.join();
+			exit( 0 );
+		}
+		int status = 0;
+		while ( waitpid( pid, &status, 0 ) == -1 )
+			;
+		if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+		{
+			printf( "child %zd failed (%s %d)\n", i, WIFSIGNALED( status ) ? "signal" : "exit code", WIFSIGNALED( status ) ? WTERMSIG( status ) : WEXITSTATUS( status ) );
+			++failed;
+		}
+	}
+
+	stopRequested.store( true, std::memory_order_relaxed );
+	for ( size_t i=0; i<thread_count; ++i )
+		threads[i].join();
+	printf( failed == 0 ? "fork test passed\n" : "fork test FAILED\n" );
+	return failed == 0 ? 0 : 1;
+}
@@ -38,6 +38,7 @@
 #include <cstdlib>
 #include <cstddef>
 #include <memory>
+#include <new>
 #include <cstring>
 #include <limits>
 
@@ -46,7 +47,11 @@
 #include <fcntl.h>
 
 
-thread_local SerializableAllocatorBase g_AllocManager;
+RegionOwnerMap g_RegionOwnerMap;
+PagePurger g_PagePurger;
+CentralBlockPool g_CentralBlockPool;
+std::atomic<bool> g_UseHugePages( getenv( "IIBMALLOC_HUGE_PAGES" ) != nullptr && atoi( getenv( "IIBMALLOC_HUGE_PAGES" ) ) != 0 );
+thread_local AllocManagerT g_AllocManager;
 
 
 // void* operator new(std::size_t count)
@@ -69,14 +74,61 @@ thread_local SerializableAllocatorBase g_AllocManager;
 // 	g_AllocManager.deallocate(ptr);
 // }
 
-#if __cplusplus >= 201703L
+// as with the plain ones above (commented out), aligned operator new/delete are replaced only in builds where g_AllocManager is to replace
+// the global allocator (otherwise, say, over-aligned objects of the tester itself would be taken from g_AllocManager)
+#if __cplusplus >= 201703L && defined IIBMALLOC_REPLACE_GLOBAL_NEW_DELETE
 
-//We don't support alignment new/delete yet
+void* operator new(std::size_t count, std::align_val_t alignment)
+{
+	return g_AllocManager.allocateAligned(count, static_cast<std::size_t>(alignment));
+}
 
-//void* operator new(std::size_t count, std::align_val_t alignment);
-//void* operator new[](std::size_t count, std::align_val_t alignment);
-//void operator delete(void* ptr, std::align_val_t al) noexcept;
-//void operator delete[](void* ptr, std::align_val_t al) noexcept;
+void* operator new[](std::size_t count, std::align_val_t alignment)
+{
+	return g_AllocManager.allocateAligned(count, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t count, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return g_AllocManager.allocateAligned(count, static_cast<std::size_t>(alignment)); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new[](std::size_t count, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return g_AllocManager.allocateAligned(count, static_cast<std::size_t>(alignment)); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void operator delete(void* ptr, std::align_val_t al) noexcept
+{
+	g_AllocManager.deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t al) noexcept
+{
+	g_AllocManager.deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t sz, std::align_val_t al) noexcept
+{
+	g_AllocManager.deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t sz, std::align_val_t al) noexcept
+{
+	g_AllocManager.deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+	g_AllocManager.deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+	g_AllocManager.deallocate(ptr);
+}
 #endif
 
 
@@ -0,0 +1,298 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * iibmalloc allocator -- drop-in replacement of malloc() and operator new
+ * 
+ * Usage: LD_PRELOAD=libiibmalloc.so <command> (or link with libiibmalloc.so).
+ * Each thread gets a heap on its first call (there is no thread_local object to be constructed,
+ * so calls made before static initialization or while a thread is being torn down are served as well).
+ * Heaps are never destroyed: a heap of an exited thread keeps objects still in use elsewhere valid,
+ * takes remote frees, and is handed over to a thread started later.
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "iibmalloc.h"
+
+#include <new>
+#include <mutex>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define IIBMALLOC_EXPORT extern "C" __attribute__((visibility("default")))
+// must not allocate on first access; as the library may also be loaded with dlmopen() (see shared_object_allocator.h), where
+// initial-exec TLS comes from a small static TLS surplus, the whole TLS of the library is to be kept to a few words
+#define IIBMALLOC_TLS __thread __attribute__((tls_model("initial-exec")))
+
+RegionOwnerMap g_RegionOwnerMap;
+PagePurger g_PagePurger;
+CentralBlockPool g_CentralBlockPool;
+std::atomic<bool> g_UseHugePages( getenv( "IIBMALLOC_HUGE_PAGES" ) != nullptr && atoi( getenv( "IIBMALLOC_HUGE_PAGES" ) ) != 0 );
+
+// larger requests cannot be satisfied anyway, and sizes of pages to be mapped would overflow
+static constexpr size_t max_request_size = ((size_t)1) << 47;
+
+// malloc() results are to be aligned for any type (as alignof( max_align_t ), that is, ALIGNMENT), while items of some
+// buckets are not (8 and 24 bytes with HalfExpBucketSizes); sizes rounded up this way map to buckets aligned as required
+static_assert( alignof( max_align_t ) <= ALIGNMENT, "" );
+static FORCE_INLINE size_t alignedRequestSize( size_t sz ) { return sz <= ALIGNMENT ? ALIGNMENT : alignUpExp( sz, ALIGNMENT_EXP ); }
+
+static ParkedHeapList<SerializableAllocatorBase> g_ParkedHeaps;
+static pthread_key_t g_ThreadExitKey;
+static pthread_once_t g_ThreadExitKeyOnce = PTHREAD_ONCE_INIT;
+
+static IIBMALLOC_TLS SerializableAllocatorBase* tlsHeap = nullptr;
+
+static void onThreadExit( void* heap )
+{
+	tlsHeap = nullptr;
+	g_ParkedHeaps.park( reinterpret_cast<SerializableAllocatorBase*>( heap ) );
+}
+
+static void createThreadExitKey()
+{
+	pthread_key_create( &g_ThreadExitKey, onThreadExit );
+}
+
+// a heap attached after thread-exit destructors have been run is not parked any longer; it is just not reused
+static NOINLINE SerializableAllocatorBase* attachHeap()
+{
+	SerializableAllocatorBase* heap = g_ParkedHeaps.adopt();
+	tlsHeap = heap;
+	pthread_once( &g_ThreadExitKeyOnce, createThreadExitKey );
+	pthread_setspecific( g_ThreadExitKey, heap );
+	return heap;
+}
+
+static FORCE_INLINE SerializableAllocatorBase* getHeap()
+{
+	SerializableAllocatorBase* heap = tlsHeap;
+	if ( heap != nullptr )
+		return heap;
+	return attachHeap();
+}
+
+// a child has only the forking thread; heaps of the others are not parked and stay as they are;
+// process-wide locks are held over fork() (g_PagePurger registers handlers of its own)
+static void lockBeforeFork()
+{
+	g_ParkedHeaps.lock();
+	g_CentralBlockPool.lockAll();
+}
+static void unlockAfterFork()
+{
+	g_CentralBlockPool.unlockAll();
+	g_ParkedHeaps.unlock();
+}
+
+__attribute__((constructor))
+static void initPreload()
+{
+	pthread_atfork( lockBeforeFork, unlockAfterFork, unlockAfterFork );
+}
+
+
+static FORCE_INLINE void* allocateOrNull( size_t sz )
+{
+	if ( sz > max_request_size )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+	try
+	{
+		return getHeap()->allocate( alignedRequestSize( sz ) );
+	}
+	catch ( const std::bad_alloc& )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+static FORCE_INLINE void* allocateAlignedOrNull( size_t sz, size_t alignment )
+{
+	if ( sz > max_request_size || alignment > max_request_size )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+	try
+	{
+		return getHeap()->allocateAligned( sz, alignment );
+	}
+	catch ( const std::bad_alloc& )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+static FORCE_INLINE void deallocate( void* ptr )
+{
+	if ( ptr != nullptr )
+		getHeap()->deallocate( ptr );
+}
+
+IIBMALLOC_EXPORT void* malloc( size_t sz )
+{
+	return allocateOrNull( sz );
+}
+
+IIBMALLOC_EXPORT void free( void* ptr )
+{
+	deallocate( ptr );
+}
+
+IIBMALLOC_EXPORT void cfree( void* ptr )
+{
+	deallocate( ptr );
+}
+
+IIBMALLOC_EXPORT void* calloc( size_t count, size_t sz )
+{
+	size_t total;
+	if ( __builtin_mul_overflow( count, sz, &total ) )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+	void* ret = allocateOrNull( total );
+	if ( ret != nullptr )
+		memset( ret, 0, total );
+	return ret;
+}
+
+IIBMALLOC_EXPORT void* realloc( void* ptr, size_t sz )
+{
+	if ( ptr == nullptr )
+		return allocateOrNull( sz );
+	if ( sz > max_request_size )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+	try
+	{
+		return getHeap()->reallocate( ptr, sz != 0 ? alignedRequestSize( sz ) : 0 ); // 0 means freeing
+	}
+	catch ( const std::bad_alloc& )
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+}
+
+IIBMALLOC_EXPORT int posix_memalign( void** ptr, size_t alignment, size_t sz )
+{
+	if ( alignment < sizeof( void* ) || ( alignment & ( alignment - 1 ) ) != 0 )
+		return EINVAL;
+	void* ret = allocateAlignedOrNull( sz, alignment );
+	if ( ret == nullptr )
+		return ENOMEM;
+	*ptr = ret;
+	return 0;
+}
+
+IIBMALLOC_EXPORT void* aligned_alloc( size_t alignment, size_t sz )
+{
+	if ( alignment == 0 || ( alignment & ( alignment - 1 ) ) != 0 )
+	{
+		errno = EINVAL;
+		return nullptr;
+	}
+	return allocateAlignedOrNull( sz, alignment );
+}
+
+IIBMALLOC_EXPORT void* memalign( size_t alignment, size_t sz )
+{
+	return aligned_alloc( alignment, sz );
+}
+
+IIBMALLOC_EXPORT void* valloc( size_t sz )
+{
+	return allocateAlignedOrNull( sz, PAGE_SIZE );
+}
+
+IIBMALLOC_EXPORT void* pvalloc( size_t sz )
+{
+	return allocateAlignedOrNull( alignUpExp( sz, PAGE_SIZE_EXP ), PAGE_SIZE );
+}
+
+IIBMALLOC_EXPORT size_t malloc_usable_size( void* ptr )
+{
+	if ( ptr == nullptr )
+		return 0;
+	return getHeap()->getAllocatedSize( ptr );
+}
+
+
+// alignment: 0 for plain operator new()
+static void* newImpl( size_t sz, size_t alignment )
+{
+	void* ret = alignment == 0 ? allocateOrNull( sz ) : allocateAlignedOrNull( sz, alignment );
+	while ( ret == nullptr )
+	{
+		std::new_handler handler = std::get_new_handler();
+		if ( handler == nullptr )
+			throw std::bad_alloc();
+		handler();
+		ret = alignment == 0 ? allocateOrNull( sz ) : allocateAlignedOrNull( sz, alignment );
+	}
+	return ret;
+}
+
+__attribute__((visibility("default"))) void* operator new( size_t sz ) { return newImpl( sz, 0 ); }
+__attribute__((visibility("default"))) void* operator new[]( size_t sz ) { return newImpl( sz, 0 ); }
+__attribute__((visibility("default"))) void* operator new( size_t sz, const std::nothrow_t& ) noexcept { return allocateOrNull( sz ); }
+__attribute__((visibility("default"))) void* operator new[]( size_t sz, const std::nothrow_t& ) noexcept { return allocateOrNull( sz ); }
+__attribute__((visibility("default"))) void* operator new( size_t sz, std::align_val_t al ) { return newImpl( sz, (size_t)al ); }
+__attribute__((visibility("default"))) void* operator new[]( size_t sz, std::align_val_t al ) { return newImpl( sz, (size_t)al ); }
+__attribute__((visibility("default"))) void* operator new( size_t sz, std::align_val_t al, const std::nothrow_t& ) noexcept { return allocateAlignedOrNull( sz, (size_t)al ); }
+__attribute__((visibility("default"))) void* operator new[]( size_t sz, std::align_val_t al, const std::nothrow_t& ) noexcept { return allocateAlignedOrNull( sz, (size_t)al ); }
+__attribute__((visibility("default"))) void operator delete( void* ptr ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete[]( void* ptr ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete( void* ptr, const std::nothrow_t& ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete[]( void* ptr, const std::nothrow_t& ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete( void* ptr, size_t ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete[]( void* ptr, size_t ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete( void* ptr, std::align_val_t ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete[]( void* ptr, std::align_val_t ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete( void* ptr, std::align_val_t, const std::nothrow_t& ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete[]( void* ptr, std::align_val_t, const std::nothrow_t& ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete( void* ptr, size_t, std::align_val_t ) noexcept { deallocate( ptr ); }
+__attribute__((visibility("default"))) void operator delete[]( void* ptr, size_t, std::align_val_t ) noexcept { deallocate( ptr ); }
@@ -40,6 +40,13 @@
 #define PAGE_ALLOCATOR_H
 
 #include "iibmalloc_common.h"
+#include "bucket_sizes.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <mutex>
 
 #define GET_PERF_DATA
 
@@ -64,10 +71,14 @@ public:
 	static void decommit(uintptr_t addr, size_t size);
 
 	static void* allocate(size_t size);
+	static void* allocateAligned(size_t size, size_t alignment); // alignment: power of 2, multiple of page size
+	static void* allocateHugeAligned(size_t size, size_t alignment); // as above, but backed with huge pages where possible; alignment: multiple of huge page size
 	static void deallocate(void* ptr, size_t size);
+	static void* reallocate(void* ptr, size_t oldSize, size_t newSize); // may move the block; returns nullptr if not supported
 //	static void release(void* addr);
 
 	static void* AllocateAddressSpace(size_t size);
+	static void* AllocateAlignedAddressSpace(size_t size, size_t alignment);
 	static void* CommitMemory(void* addr, size_t size);
 	static void DecommitMemory(void* addr, size_t size);
 	static void FreeAddressSpace(void* addr, size_t size);
@@ -179,6 +190,12 @@ public:
 		return lst.listGetNext();
 	}
 
+	FORCE_INLINE
+	MemoryBlockListItem* back()
+	{
+		return lst.listGetPrev();
+	}
+
 	FORCE_INLINE
 	void pushFront(MemoryBlockListItem* chk)
 	{
@@ -186,6 +203,13 @@ public:
 		++count;
 	}
 
+	FORCE_INLINE
+	void pushBack(MemoryBlockListItem* chk)
+	{
+		lst.listGetPrev()->listInsertNext(chk);
+		++count;
+	}
+
 	FORCE_INLINE
 	MemoryBlockListItem* popFront()
 	{
@@ -237,6 +261,17 @@ struct BlockStats
 	uint64_t deallocRequestCount = 0;
 	uint64_t deallocRequestSize = 0;
 
+	// refills of buckets with spans of pages (including reserving and committing pages, if necessary)
+	uint64_t refillCount = 0;
+	uint64_t refillSyscallCount = 0;
+	uint64_t rdtscRefillSpent = 0;
+
+	// requests for large blocks served from / missed by LargeBlockCache; hits include those refilled from CentralBlockPool
+	uint64_t largeCacheHitCount = 0;
+	uint64_t largeCacheMissCount = 0;
+	uint64_t largePoolHitCount = 0;
+	uint64_t largePoolPutCount = 0;
+
 	void printStats()
 	{
 		printf("Allocs %zd (%zd), ", sysAllocCount, sysAllocSize);
@@ -245,7 +280,12 @@ struct BlockStats
 		uint64_t ct = sysAllocCount - sysDeallocCount;
 		uint64_t sz = sysAllocSize - sysDeallocSize;
 
-		printf("Diff %zd (%zd)\n\n", ct, sz);
+		printf("Diff %zd (%zd)\n", ct, sz);
+		if ( refillCount )
+			printf("Refills %zd (%.1f ticks, %.2f syscalls per refill)\n", refillCount, rdtscRefillSpent * 1. / refillCount, refillSyscallCount * 1. / refillCount);
+		if ( largeCacheHitCount + largeCacheMissCount )
+			printf("Large block cache: %zd hits (%zd via the central pool), %zd misses (hit rate %.1f%%); %zd blocks handed over to the central pool\n", largeCacheHitCount, largePoolHitCount, largeCacheMissCount, largeCacheHitCount * 100. / ( largeCacheHitCount + largeCacheMissCount ), largePoolPutCount );
+		printf("\n");
 	}
 
 	void registerAllocRequest( size_t sz )
@@ -271,6 +311,18 @@ struct BlockStats
 		rdtscSysDeallocSpent += rdtscSpent;
 		++sysDeallocCount;
 	}
+
+	void registerRefill( size_t syscallCount, uint64_t rdtscSpent )
+	{
+		refillSyscallCount += syscallCount;
+		rdtscRefillSpent += rdtscSpent;
+		++refillCount;
+	}
+
+	void registerLargeCacheHit() { ++largeCacheHitCount; }
+	void registerLargeCacheMiss() { ++largeCacheMissCount; }
+	void registerLargePoolHit() { ++largePoolHitCount; }
+	void registerLargePoolPut() { ++largePoolPutCount; }
 };
 
 struct PageAllocator // rather a proof of concept
@@ -353,10 +405,387 @@ constexpr size_t max_cached_size = 20; // # of pages
 constexpr size_t single_page_cache_size = 32;
 constexpr size_t multi_page_cache_size = 4;
 
+// bytes a thread keeps for itself without CentralBlockPool; with the pool, its budget is taken out of that (down to
+// large_cache_min_budget), so that while the pool budget is below the difference, a process keeps no more memory
+// with idle threads than it would without the pool
+constexpr size_t large_cache_budget = 8 * 1024 * 1024;
+constexpr size_t large_cache_min_budget = 1024 * 1024;
+constexpr size_t large_cache_max_block_size = 8 * 1024 * 1024;
+constexpr uint64_t large_cache_max_age_ms = 1000;
+constexpr size_t large_pool_default_budget_mb = 6;
+constexpr uint64_t large_pool_sweep_ms = 100; // all bins of the pool are checked for aged blocks at most this often
+constexpr size_t large_pool_batch_size = 1024 * 1024; // bytes taken from CentralBlockPool at once, if available
+
+// a freed large block kept mapped for reuse
+struct CachedLargeBlock : public MemoryBlockListItem
+{
+	uint64_t freedAt; // ms
+};
+
+// Size classes of cached large blocks, four per power of 2 from min_size to max_size
+struct LargeBlockClasses
+{
+	static constexpr size_t min_size = 16 * 1024; // smaller blocks are never cached
+	static constexpr size_t max_size = large_cache_max_block_size;
+	static_assert( ( min_size & ( min_size - 1 ) ) == 0 && ( max_size & ( max_size - 1 ) ) == 0, "" );
+
+	static constexpr size_t min_class = ((size_t)( highestBitIdxConstexpr( min_size ) - 2 )) << 2;
+	static constexpr size_t bin_count = ( ((size_t)( highestBitIdxConstexpr( max_size ) - 2 )) << 2 ) - min_class + 1;
+
+	// of the largest class not above sz
+	static size_t floorBinIdx( size_t sz )
+	{
+		assert( sz >= min_size );
+		uint8_t shift = highestBitIdx( sz ) - 2;
+		return ( ((size_t)shift) << 2 ) + ( ( sz >> shift ) & 3 ) - min_class;
+	}
+	static constexpr size_t binToSize( size_t idx ) { return ( 4 + ( ( idx + min_class ) & 3 ) ) << ( ( idx + min_class ) >> 2 ); }
+
+	static uint64_t nowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	static void unmap( CachedLargeBlock* block, BlockStats& stats )
+	{
+		size_t sz = block->getSize();
+		uint64_t start = __rdtsc();
+		VirtualMemory::deallocate( block, sz );
+		uint64_t end = __rdtsc();
+		stats.registerSysDealloc( sz, end - start );
+	}
+};
+
+// Process-wide pool of large blocks that LargeBlockCache of each thread overflows into and refills from,
+// so that blocks freed by a thread gone idle can serve busy ones. Bins are those of LargeBlockClasses, each
+// with its own lock. At most a budget of bytes is pooled (IIBMALLOC_CENTRAL_POOL_MB environment variable,
+// 6 by default, also at runtime with setBudget(); 0 disables the pool), and it is taken out of per-thread budgets
+// (see threadBudget()). Blocks older than large_cache_max_age_ms are unmapped by sweepAged(), which any operation
+// of any thread with large blocks (and the g_PagePurger thread, if running) calls, so they do not stay with
+// the pool when the threads that put them there are idle.
+// Zero-initialized is empty and disabled, as heaps may be used before g_CentralBlockPool is constructed.
+class CentralBlockPool
+{
+	// linked via MemoryBlockListItem::next from the newest to the oldest block
+	struct Bin
+	{
+		std::mutex mx;
+		CachedLargeBlock* newest;
+		CachedLargeBlock* oldest;
+	};
+
+	Bin bins[LargeBlockClasses::bin_count];
+	std::atomic<size_t> pooledSize;
+	std::atomic<size_t> budget;
+	std::atomic<uint64_t> nextSweepMs;
+
+	static size_t budgetFromEnv()
+	{
+		const char* val = getenv( "IIBMALLOC_CENTRAL_POOL_MB" );
+		return ( val != nullptr ? strtoull( val, nullptr, 10 ) : large_pool_default_budget_mb ) << 20;
+	}
+
+	// under lock; aged blocks are returned linked via next to be unmapped out of the lock
+	CachedLargeBlock* detachAged( Bin& bin, uint64_t now )
+	{
+		CachedLargeBlock* ret = nullptr;
+		while ( bin.oldest != nullptr && now - bin.oldest->freedAt > large_cache_max_age_ms )
+		{
+			CachedLargeBlock* block = bin.oldest;
+			bin.oldest = static_cast<CachedLargeBlock*>( block->prev );
+			if ( bin.oldest != nullptr )
+				bin.oldest->next = nullptr;
+			else
+				bin.newest = nullptr;
+			pooledSize.fetch_sub( block->getSize(), std::memory_order_relaxed );
+			block->next = ret;
+			ret = block;
+		}
+		return ret;
+	}
+
+	static void unmapAll( CachedLargeBlock* block, BlockStats& stats )
+	{
+		while ( block != nullptr )
+		{
+			CachedLargeBlock* next = static_cast<CachedLargeBlock*>( block->next );
+			LargeBlockClasses::unmap( block, stats );
+			block = next;
+		}
+	}
+
+public:
+	CentralBlockPool()
+	{
+		budget.store( budgetFromEnv(), std::memory_order_relaxed );
+	}
+
+	// blocks already pooled stay there until taken or aged
+	void setBudget( size_t bytes ) { budget.store( bytes, std::memory_order_relaxed ); }
+	size_t getBudget() const { return budget.load( std::memory_order_relaxed ); }
+	size_t getPooledSize() const { return pooledSize.load( std::memory_order_relaxed ); }
+
+	// bytes LargeBlockCache of each thread keeps for itself
+	size_t threadBudget() const
+	{
+		size_t poolBudget = budget.load( std::memory_order_relaxed );
+		return poolBudget < large_cache_budget - large_cache_min_budget ? large_cache_budget - poolBudget : large_cache_min_budget;
+	}
+
+	// unmaps aged blocks of all bins, if not done within large_pool_sweep_ms (by whichever thread comes first)
+	void sweepAged( uint64_t now, BlockStats& stats )
+	{
+		uint64_t next = nextSweepMs.load( std::memory_order_relaxed );
+		if ( now < next || pooledSize.load( std::memory_order_relaxed ) == 0 )
+			return;
+		if ( !nextSweepMs.compare_exchange_strong( next, now + large_pool_sweep_ms, std::memory_order_relaxed ) )
+			return;
+		for ( size_t i=0; i<LargeBlockClasses::bin_count; ++i )
+		{
+			Bin& bin = bins[i];
+			CachedLargeBlock* aged;
+			{
+				std::lock_guard<std::mutex> lock( bin.mx );
+				aged = detachAged( bin, now );
+			}
+			unmapAll( aged, stats );
+		}
+	}
+
+	// the newest blocks of a bin, at least one (if any) and as many as fit into batchSize bytes in total;
+	// returned linked via next from the newest
+	CachedLargeBlock* take( size_t idx, size_t batchSize, BlockStats& stats )
+	{
+		assert( idx < LargeBlockClasses::bin_count );
+		if ( pooledSize.load( std::memory_order_relaxed ) == 0 )
+			return nullptr;
+		Bin& bin = bins[idx];
+		MemoryBlockListItem* ret = nullptr;
+		CachedLargeBlock* aged;
+		{
+			std::lock_guard<std::mutex> lock( bin.mx );
+			aged = detachAged( bin, LargeBlockClasses::nowMs() );
+			size_t takenSize = 0;
+			MemoryBlockListItem** tail = &ret;
+			while ( bin.newest != nullptr && ( takenSize == 0 || takenSize + bin.newest->getSize() <= batchSize ) )
+			{
+				CachedLargeBlock* block = bin.newest;
+				bin.newest = static_cast<CachedLargeBlock*>( block->next );
+				takenSize += block->getSize();
+				*tail = block;
+				tail = &(block->next);
+			}
+			*tail = nullptr;
+			if ( bin.newest != nullptr )
+				bin.newest->prev = nullptr;
+			else
+				bin.oldest = nullptr;
+			pooledSize.fetch_sub( takenSize, std::memory_order_relaxed );
+		}
+		unmapAll( aged, stats );
+		return static_cast<CachedLargeBlock*>( ret );
+	}
+
+	// returns false if the pool is full or disabled; the block is then to be unmapped by the caller
+	bool put( size_t idx, CachedLargeBlock* block, BlockStats& stats )
+	{
+		assert( idx < LargeBlockClasses::bin_count );
+		size_t sz = block->getSize();
+		if ( pooledSize.fetch_add( sz, std::memory_order_relaxed ) + sz > budget.load( std::memory_order_relaxed ) )
+		{
+			pooledSize.fetch_sub( sz, std::memory_order_relaxed );
+			return false;
+		}
+		Bin& bin = bins[idx];
+		CachedLargeBlock* aged;
+		{
+			std::lock_guard<std::mutex> lock( bin.mx );
+			aged = detachAged( bin, LargeBlockClasses::nowMs() );
+			block->prev = nullptr;
+			block->next = bin.newest;
+			if ( bin.newest != nullptr )
+				bin.newest->prev = block;
+			else
+				bin.oldest = block;
+			bin.newest = block;
+		}
+		unmapAll( aged, stats );
+		return true;
+	}
+
+	// around fork(), for bins to be consistent in a child
+	void lockAll()
+	{
+		for ( size_t i=0; i<LargeBlockClasses::bin_count; ++i )
+			bins[i].mx.lock();
+	}
+	void unlockAll()
+	{
+		for ( size_t i=LargeBlockClasses::bin_count; i>0; --i )
+			bins[i-1].mx.unlock();
+	}
+
+	// unmaps all pooled blocks
+	void release( BlockStats& stats )
+	{
+		for ( size_t i=0; i<LargeBlockClasses::bin_count; ++i )
+		{
+			Bin& bin = bins[i];
+			CachedLargeBlock* all;
+			{
+				std::lock_guard<std::mutex> lock( bin.mx );
+				all = bin.newest;
+				for ( CachedLargeBlock* block = all; block != nullptr; block = static_cast<CachedLargeBlock*>( block->next ) )
+					pooledSize.fetch_sub( block->getSize(), std::memory_order_relaxed );
+				bin.newest = nullptr;
+				bin.oldest = nullptr;
+			}
+			unmapAll( all, stats );
+		}
+	}
+};
+
+extern CentralBlockPool g_CentralBlockPool;
+
+// Recently freed large blocks, kept mapped to be reused instead of mapping and unmapping one for each request.
+// A freed block goes to the bin of the largest class not above its size, and a request is served from the bin
+// of the smallest class not below it; blocks mapped on a miss are rounded up to that class for them to fit any
+// request of the bin later. Over CentralBlockPool::threadBudget() bytes, the oldest blocks are handed over to g_CentralBlockPool,
+// which is also where empty bins are refilled from; blocks older than large_cache_max_age_ms are unmapped
+// at any operation with the cache.
+class LargeBlockCache
+{
+	typedef LargeBlockClasses Classes;
+
+	MemoryBlockList bins[Classes::bin_count];
+	size_t cachedSize;
+
+	// bins are ordered from the newest to the oldest block
+	CachedLargeBlock* oldest()
+	{
+		CachedLargeBlock* ret = nullptr;
+		for ( size_t i=0; i<Classes::bin_count; ++i )
+			if ( !bins[i].empty() )
+			{
+				CachedLargeBlock* candidate = static_cast<CachedLargeBlock*>( bins[i].back() );
+				if ( ret == nullptr || candidate->freedAt < ret->freedAt )
+					ret = candidate;
+			}
+		return ret;
+	}
+
+	void handOver( CachedLargeBlock* block, BlockStats& stats )
+	{
+		if ( g_CentralBlockPool.put( block->getSizeIndex(), block, stats ) )
+			stats.registerLargePoolPut();
+		else
+			Classes::unmap( block, stats );
+	}
+
+	void evictAged( uint64_t now, BlockStats& stats )
+	{
+		g_CentralBlockPool.sweepAged( now, stats );
+		for ( size_t i=0; i<Classes::bin_count; ++i )
+			while ( !bins[i].empty() )
+			{
+				CachedLargeBlock* block = static_cast<CachedLargeBlock*>( bins[i].back() );
+				if ( now - block->freedAt <= large_cache_max_age_ms )
+					break;
+				bins[i].remove( block );
+				cachedSize -= block->getSize();
+				Classes::unmap( block, stats );
+			}
+	}
+
+public:
+	void initialize()
+	{
+		for ( size_t i=0; i<Classes::bin_count; ++i )
+			bins[i].initialize();
+		cachedSize = 0;
+	}
+
+	// blocks are handed over to g_CentralBlockPool, if it has room for them
+	void flush( BlockStats& stats )
+	{
+		for ( size_t i=0; i<Classes::bin_count; ++i )
+			while ( !bins[i].empty() )
+				handOver( static_cast<CachedLargeBlock*>( bins[i].popFront() ), stats );
+		cachedSize = 0;
+	}
+
+	// returns a cached block or nullptr; in the latter case sz is updated to the size of a block to be mapped
+	void* get( size_t& sz, BlockStats& stats )
+	{
+		if ( sz < Classes::min_size || sz > Classes::max_size )
+			return nullptr;
+		size_t idx = Classes::floorBinIdx( sz );
+		if ( Classes::binToSize( idx ) != sz )
+			++idx;
+		if ( idx >= Classes::bin_count )
+			return nullptr;
+		evictAged( Classes::nowMs(), stats );
+		CachedLargeBlock* block;
+		if ( !bins[idx].empty() )
+		{
+			block = static_cast<CachedLargeBlock*>( bins[idx].popFront() );
+			cachedSize -= block->getSize();
+		}
+		else
+		{
+			block = g_CentralBlockPool.take( idx, large_pool_batch_size, stats );
+			if ( block == nullptr )
+			{
+				stats.registerLargeCacheMiss();
+				sz = Classes::binToSize( idx );
+				return nullptr;
+			}
+			stats.registerLargePoolHit();
+			// the rest of the batch, from the newest, goes to the (empty) bin as it is
+			for ( CachedLargeBlock* next = static_cast<CachedLargeBlock*>( block->next ); next != nullptr; )
+			{
+				CachedLargeBlock* curr = next;
+				next = static_cast<CachedLargeBlock*>( curr->next );
+				curr->next = nullptr;
+				curr->prev = nullptr;
+				bins[idx].pushBack( curr );
+				cachedSize += curr->getSize();
+			}
+		}
+		stats.registerLargeCacheHit();
+		sz = block->getSize();
+		return block;
+	}
+
+	// returns false if the block is to be unmapped by the caller
+	bool put( void* ptr, size_t sz, BlockStats& stats )
+	{
+		if ( sz < Classes::min_size || sz > Classes::max_size )
+			return false;
+		uint64_t now = Classes::nowMs();
+		evictAged( now, stats );
+		size_t idx = Classes::floorBinIdx( sz );
+		CachedLargeBlock* block = static_cast<CachedLargeBlock*>( ptr );
+		block->initialize( sz, idx );
+		block->freedAt = now;
+		bins[idx].pushFront( block );
+		cachedSize += sz;
+		while ( cachedSize > g_CentralBlockPool.threadBudget() )
+		{
+			CachedLargeBlock* old = oldest();
+			bins[ old->getSizeIndex() ].remove( old );
+			cachedSize -= old->getSize();
+			handOver( old, stats );
+		}
+		return true;
+	}
+};
+
 struct PageAllocatorWithCaching // to be further developed for practical purposes
 {
 //	Chunk* topChunk = nullptr;
 	std::array<MemoryBlockList, max_cached_size+1> freeBlocks;
+	LargeBlockCache largeBlocks;
 
 	BlockStats stats;
 	//uintptr_t blocksBegin = 0;
@@ -371,6 +800,7 @@ public:
 		this->blockSizeExp = blockSizeExp;
 		for ( size_t ix=0; ix<=max_cached_size; ++ ix )
 			freeBlocks[ix].initialize();
+		largeBlocks.initialize();
 	}
 
 	void deinitialize()
@@ -387,6 +817,7 @@ public:
 				stats.registerSysDealloc( sz, end - start );
 			}
 		}
+		largeBlocks.flush( stats );
 	}
 
 	MemoryBlockListItem* getFreeBlock(size_t sz)
@@ -441,6 +872,53 @@ public:
 		throw std::bad_alloc();
 	}
 
+	// as getFreeBlockNoCache(), but reuses blocks released with freeLargeBlock(); sz is updated to the actual size of the block
+	void* getLargeBlock(size_t& sz)
+	{
+		void* ptr = largeBlocks.get( sz, stats );
+		if ( ptr == nullptr )
+			return getFreeBlockNoCache( sz );
+		stats.registerAllocRequest( sz );
+		return ptr;
+	}
+
+	// returns false if the block is too large to be cached and is to be released by the caller
+	bool freeLargeBlock( void* block, size_t sz )
+	{
+		if ( !largeBlocks.put( block, sz, stats ) )
+			return false;
+		stats.registerDeallocRequest( sz );
+		return true;
+	}
+
+	void flushLargeBlocks()
+	{
+		largeBlocks.flush( stats );
+	}
+
+	void releasePooledBlocks()
+	{
+		g_CentralBlockPool.release( stats );
+	}
+
+	void* getFreeAlignedBlockNoCache(size_t sz, size_t alignmentExp)
+	{
+		stats.registerAllocRequest( sz );
+
+		assert(isAlignedExp(sz, blockSizeExp));
+		assert(alignmentExp >= blockSizeExp);
+
+		uint64_t start = __rdtsc();
+		void* ptr = VirtualMemory::allocateAligned(sz, ((size_t)1) << alignmentExp);
+		uint64_t end = __rdtsc();
+		stats.registerSysAlloc( sz, end - start );
+
+		if (ptr)
+			return ptr;
+
+		throw std::bad_alloc();
+	}
+
 
 	void freeChunk( MemoryBlockListItem* chk )
 	{
@@ -486,6 +964,23 @@ public:
 		stats.registerSysDealloc( sz, end - start );
 	}
 
+	// resizes a block obtained with getFreeBlockNoCache(); returns nullptr if the OS cannot do it
+	void* reallocateNoCache( void* block, size_t oldSz, size_t newSz )
+	{
+		stats.registerDeallocRequest( oldSz );
+		stats.registerAllocRequest( newSz );
+
+		uint64_t start = __rdtsc();
+		void* ptr = VirtualMemory::reallocate( block, oldSz, newSz );
+		uint64_t end = __rdtsc();
+		if ( ptr )
+		{
+			stats.registerSysDealloc( oldSz, 0 );
+			stats.registerSysAlloc( newSz, end - start );
+		}
+		return ptr;
+	}
+
 	const BlockStats& getStats() const { return stats; }
 
 	void printStats()
@@ -497,6 +992,19 @@ public:
 	{
 		return VirtualMemory::AllocateAddressSpace( size );
 	}
+	void* AllocateAlignedAddressSpace(size_t size, size_t alignmentExp)
+	{
+		return VirtualMemory::AllocateAlignedAddressSpace( size, ((size_t)1) << alignmentExp );
+	}
+	void* AllocateHugeAlignedMemory(size_t size, size_t alignmentExp)
+	{
+		stats.registerAllocRequest( size );
+		uint64_t start = __rdtsc();
+		void* ptr = VirtualMemory::allocateHugeAligned( size, ((size_t)1) << alignmentExp );
+		uint64_t end = __rdtsc();
+		stats.registerSysAlloc( size, end - start );
+		return ptr;
+	}
 	void* CommitMemory(void* addr, size_t size)
 	{
 		stats.registerAllocRequest( size );
@@ -571,6 +1079,30 @@ public:
 		return ret;
 	}
 
+	void* getLargeBlock(size_t& sz)
+	{
+		return getFreeBlockNoCache( sz );
+	}
+
+	bool freeLargeBlock( void* block, size_t sz )
+	{
+		return false;
+	}
+
+	void flushLargeBlocks()
+	{
+	}
+
+	void releasePooledBlocks()
+	{
+	}
+
+	void* getFreeAlignedBlockNoCache(size_t sz, size_t alignmentExp)
+	{
+		currentPtr = reinterpret_cast<uint8_t*>( alignUpExp( (uintptr_t)currentPtr, alignmentExp ) );
+		return getFreeBlockNoCache( sz );
+	}
+
 
 	void freeChunk( MemoryBlockListItem* chk )
 	{
@@ -582,6 +1114,11 @@ public:
 //		throw std::bad_alloc();
 	}
 
+	void* reallocateNoCache( void* block, size_t oldSz, size_t newSz )
+	{
+		return nullptr;
+	}
+
 	const BlockStats& getStats() const { return stats; }
 
 	void printStats()
@@ -600,6 +1137,15 @@ public:
 		}
 		return ret;
 	}
+	void* AllocateAlignedAddressSpace(size_t size, size_t alignmentExp)
+	{
+		currentPtr = reinterpret_cast<uint8_t*>( alignUpExp( (uintptr_t)currentPtr, alignmentExp ) );
+		return AllocateAddressSpace( size );
+	}
+	void* AllocateHugeAlignedMemory(size_t size, size_t alignmentExp)
+	{
+		return AllocateAlignedAddressSpace( size, alignmentExp );
+	}
 	void* CommitMemory(void* addr, size_t size)
 	{
 		return addr;
@@ -38,15 +38,15 @@
 #include <cstddef>
 #include <memory>
 #include <cstring>
+#include <cerrno>
 #include <limits>
+#include <atomic>
 
 #include <unistd.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 
 
-thread_local PageAllocatorWithCaching thg_PageAllocatorWithCaching;
-
 // limit below is single read or write op in linux
 static constexpr size_t MAX_LINUX = 0x7ffff000;
 // [DI: what depends on what/] static_assert(MAX_LINUX <= MAX_CHUNK_SIZE, "Use of big chunks needs review.");
@@ -98,6 +98,56 @@ void* VirtualMemory::allocate(size_t size)
 	return ptr;
 }
 
+// returns nullptr on failure if caller is nullptr
+static void* mmapAligned(size_t size, size_t alignment, int prot, int flags, const char* caller)
+{
+	// over-reserve by alignment and unmap the unaligned head and the remaining tail
+	assert( ( alignment & (alignment - 1) ) == 0 );
+	assert( size % 4096 == 0 && alignment % 4096 == 0 );
+	void* ptr = mmap(nullptr, size + alignment, prot, MAP_PRIVATE|MAP_ANONYMOUS|flags, -1, 0);
+	if (ptr == (void*)(-1))
+	{
+		if ( caller == nullptr )
+			return nullptr;
+		int e = errno;
+		printf( "mmap error at %s(%zd), error = %d (%s)\n", caller, size, e, strerror(e) );
+		throw std::bad_alloc();
+	}
+	uintptr_t start = (uintptr_t)(ptr);
+	uintptr_t alignedStart = ( start + alignment - 1 ) & ~((uintptr_t)(alignment - 1));
+	if ( alignedStart != start )
+		munmap( ptr, alignedStart - start );
+	size_t tail = start + alignment - alignedStart;
+	if ( tail )
+		munmap( (void*)(alignedStart + size), tail );
+	return (void*)(alignedStart);
+}
+
+void* VirtualMemory::allocateAligned(size_t size, size_t alignment)
+{
+	if ( alignment <= 4096 )
+		return allocate( size );
+	return mmapAligned( size, alignment, PROT_READ|PROT_WRITE, 0, "allocateAligned" );
+}
+
+void* VirtualMemory::allocateHugeAligned(size_t size, size_t alignment)
+{
+	constexpr size_t huge_page_size = 2 * 1024 * 1024;
+	assert( alignment % huge_page_size == 0 && size % huge_page_size == 0 );
+	// pages reserved for hugetlbfs, if any, are preferred; once they are exhausted, transparent huge pages are requested
+	static std::atomic<bool> hugetlbExhausted( false );
+	if ( !hugetlbExhausted.load( std::memory_order_relaxed ) )
+	{
+		void* ptr = mmapAligned( size, alignment, PROT_READ|PROT_WRITE, MAP_HUGETLB, nullptr );
+		if ( ptr != nullptr )
+			return ptr;
+		hugetlbExhausted.store( true, std::memory_order_relaxed );
+	}
+	void* ptr = mmapAligned( size, alignment, PROT_READ|PROT_WRITE, 0, "allocateHugeAligned" );
+	madvise( ptr, size, MADV_HUGEPAGE ); // if THP is disabled altogether, regular pages are used
+	return ptr;
+}
+
 void VirtualMemory::deallocate(void* ptr, size_t size)
 {
 	assert( size % 4096 == 0 );
@@ -112,6 +162,15 @@ void VirtualMemory::deallocate(void* ptr, size_t size)
 }
 
 
+void* VirtualMemory::reallocate(void* ptr, size_t oldSize, size_t newSize)
+{
+	assert( oldSize % 4096 == 0 && newSize % 4096 == 0 );
+	void* ret = mremap(ptr, oldSize, newSize, MREMAP_MAYMOVE);
+	if ( ret == (void*)(-1) )
+		return nullptr;
+	return ret;
+}
+
 
 void* VirtualMemory::AllocateAddressSpace(size_t size)
 {
@@ -125,6 +184,13 @@ void* VirtualMemory::AllocateAddressSpace(size_t size)
  //   msync(ptr, size, MS_SYNC|MS_INVALIDATE);
     return ptr;
 }
+
+void* VirtualMemory::AllocateAlignedAddressSpace(size_t size, size_t alignment)
+{
+	if ( alignment <= 4096 )
+		return AllocateAddressSpace( size );
+	return mmapAligned( size, alignment, PROT_NONE, 0, "AllocateAlignedAddressSpace" );
+}
  
 void* VirtualMemory::CommitMemory(void* addr, size_t size)
 {
@@ -131,17 +131,68 @@ void* VirtualMemory::allocate(size_t size)
 	return ptr;
 }
 
+static void* virtualAllocAligned(size_t size, size_t alignment, DWORD allocType, DWORD protect)
+{
+	// Windows cannot release a part of a reservation, so we probe for a suitable range
+	// and then try to re-reserve exactly its aligned part (which may be raced by other threads)
+	for ( size_t attempt=0; attempt<16; ++attempt )
+	{
+		void* probe = VirtualAlloc(0, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+		if (!probe)
+			return nullptr;
+		uintptr_t alignedStart = ( (uintptr_t)(probe) + alignment - 1 ) & ~((uintptr_t)(alignment - 1));
+		VirtualFree(probe, 0, MEM_RELEASE);
+		void* ptr = VirtualAlloc(reinterpret_cast<void*>(alignedStart), size, allocType, protect);
+		if (ptr)
+		{
+			assert( ptr == reinterpret_cast<void*>(alignedStart) );
+			return ptr;
+		}
+	}
+	return nullptr;
+}
+
+void* VirtualMemory::allocateAligned(size_t size, size_t alignment)
+{
+	if ( alignment <= getAllocGranularity() )
+		return allocate( size );
+	void* ptr = virtualAllocAligned(size, alignment, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!ptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void* VirtualMemory::allocateHugeAligned(size_t size, size_t alignment)
+{
+	// large pages require SeLockMemoryPrivilege and cannot be committed on demand; regular ones are used
+	return allocateAligned( size, alignment );
+}
+
 void VirtualMemory::deallocate(void* ptr, size_t size)
 {
 	bool OK = VirtualFree(ptr, 0, MEM_RELEASE);
 	assert( OK );
 }
 
+void* VirtualMemory::reallocate(void* ptr, size_t oldSize, size_t newSize)
+{
+	// there is no counterpart of mremap(); callers copy
+	return nullptr;
+}
+
 
 void* VirtualMemory::AllocateAddressSpace(size_t size)
 {
     return VirtualAlloc(NULL, size, MEM_RESERVE , PAGE_NOACCESS);
 }
+
+void* VirtualMemory::AllocateAlignedAddressSpace(size_t size, size_t alignment)
+{
+	if ( alignment <= getAllocGranularity() )
+		return AllocateAddressSpace( size );
+	return virtualAllocAligned(size, alignment, MEM_RESERVE, PAGE_NOACCESS);
+}
  
 void* VirtualMemory::CommitMemory(void* addr, size_t size)
 {
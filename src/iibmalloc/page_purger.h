@@ -0,0 +1,398 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * iibmalloc allocator
+ * Page Purger:
+ *     - a process-wide background thread releasing memory that heaps have
+ *       stopped using, with a time-based decay instead of doing it right away
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+ 
+#ifndef PAGE_PURGER_H
+#define PAGE_PURGER_H
+
+#include "iibmalloc_common.h"
+#include "page_allocator.h"
+
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <new>
+#ifndef _MSC_VER
+#include <pthread.h>
+#endif
+
+class PagePurger;
+extern PagePurger g_PagePurger;
+
+// Heaps hand over ranges they no longer use: empty spans to be decommitted (while the address space is kept for reuse),
+// and large chunks to be unmapped. Ranges are released over time, as jemalloc does with its dirty/muzzy decay:
+// at any moment, at most sum( size * (1 - smoothstep( age / decay )) ) bytes of handed over ranges remain committed,
+// oldest ranges being released first. A range decommitted while being reused would be a disaster, so ranges are detached
+// and marked as being purged under the lock that takeBack() also acquires, and takeBack() of such a range waits until
+// the purger, having decommitted them with the lock released, marks them as purged; this is the only point where an owner
+// may wait for the purger. Neither add() nor takeBack() of an already purged range take the lock.
+// Decay times are tunable at runtime with setDecayTimes(), and initially are taken from IIBMALLOC_DECOMMIT_DECAY_MS
+// and IIBMALLOC_UNMAP_DECAY_MS environment variables; 0 (default) means releasing right away by the calling thread.
+// A child of fork() has no purger thread: ranges handed over by then are released by the child right away, and so are
+// those handed over later (see afterForkInChild()).
+class PagePurger
+{
+public:
+	static constexpr uint16_t purged_mark = UINT16_MAX - 1; // written to a mark of a range once it is decommitted
+	static constexpr uint16_t purging_mark = UINT16_MAX - 2; // written to a mark of a range about to be decommitted
+
+private:
+	enum { decommit_list, unmap_list, list_cnt };
+	static constexpr size_t decay_steps = 20; // ticks per decay time
+	static constexpr size_t max_tick_ms = 1000;
+
+	// stored at the start of the range itself
+	struct PurgeableRange
+	{
+		PurgeableRange* prev;
+		PurgeableRange* next;
+		size_t size;
+		uint64_t freedAt; // ms
+		void* owner;
+		uint16_t* mark;
+	};
+
+	// zero-initialized is empty, as heaps may be used before g_PagePurger is constructed
+	struct RangeList
+	{
+		PurgeableRange* oldest;
+		PurgeableRange* newest;
+		size_t dirtySize;
+
+		void pushBack( PurgeableRange* r )
+		{
+			r->next = nullptr;
+			r->prev = newest;
+			if ( newest != nullptr )
+				newest->next = r;
+			else
+				oldest = r;
+			newest = r;
+			dirtySize += r->size;
+		}
+		void remove( PurgeableRange* r )
+		{
+			if ( r->prev != nullptr )
+				r->prev->next = r->next;
+			else
+				oldest = r->next;
+			if ( r->next != nullptr )
+				r->next->prev = r->prev;
+			else
+				newest = r->prev;
+			dirtySize -= r->size;
+		}
+	};
+
+	std::mutex mx;
+	std::condition_variable cv;
+	std::condition_variable purgedCv; // notified once ranges being decommitted with mx released are purged
+	std::thread purger;
+	std::atomic<bool> running; // zero-initialized, see RangeList
+	bool stopRequested = false;
+	bool decommitInFlight = false;
+	std::atomic<size_t> decayMs[list_cnt];
+	RangeList lists[list_cnt];
+
+	// marks are in memory of owners, which read them without the lock
+	static uint16_t loadMark( const uint16_t* mark )
+	{
+#ifdef _MSC_VER
+		return *static_cast<const volatile uint16_t*>( mark );
+#else
+		return __atomic_load_n( mark, __ATOMIC_ACQUIRE );
+#endif
+	}
+	static void storeMark( uint16_t* mark, uint16_t val )
+	{
+#ifdef _MSC_VER
+		*static_cast<volatile uint16_t*>( mark ) = val;
+#else
+		__atomic_store_n( mark, val, __ATOMIC_RELEASE );
+#endif
+	}
+
+	static uint64_t nowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	static size_t decayFromEnv( const char* name )
+	{
+		const char* val = getenv( name );
+		return val != nullptr ? strtoull( val, nullptr, 10 ) : 0;
+	}
+
+	static double remainingShare( uint64_t age, size_t decay )
+	{
+		if ( age >= decay )
+			return 0;
+		double x = (double)age / decay;
+		return 1 - x * x * ( 3 - 2 * x );
+	}
+
+	size_t tickMs()
+	{
+		size_t tick = max_tick_ms;
+		for ( size_t i=0; i<list_cnt; ++i )
+		{
+			size_t decay = decayMs[i].load( std::memory_order_relaxed );
+			if ( decay != 0 && tick > decay / decay_steps )
+				tick = decay / decay_steps;
+		}
+		return tick != 0 ? tick : 1;
+	}
+
+	// unlinks ranges to be released by now; they are returned linked via PurgeableRange::next
+	PurgeableRange* detachExpired( RangeList& list, uint64_t now, size_t decay )
+	{
+		double limit = 0;
+		for ( PurgeableRange* r = list.oldest; r != nullptr; r = r->next )
+			limit += r->size * remainingShare( now - r->freedAt, decay );
+		PurgeableRange* ret = nullptr;
+		PurgeableRange** tail = &ret;
+		while ( list.oldest != nullptr && list.dirtySize > limit )
+		{
+			PurgeableRange* r = list.oldest;
+			list.remove( r );
+			*tail = r;
+			tail = &(r->next);
+		}
+		*tail = nullptr;
+		return ret;
+	}
+
+	static void decommitRanges( PurgeableRange* r )
+	{
+		while ( r != nullptr )
+		{
+			PurgeableRange* next = r->next;
+			uint16_t* mark = r->mark;
+			VirtualMemory::DecommitMemory( r, r->size );
+			storeMark( mark, purged_mark );
+			r = next;
+		}
+	}
+
+	static void unmapRanges( PurgeableRange* r )
+	{
+		while ( r != nullptr )
+		{
+			PurgeableRange* next = r->next;
+			VirtualMemory::deallocate( r, r->size );
+			r = next;
+		}
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock( mx );
+		while ( !stopRequested )
+		{
+			cv.wait_for( lock, std::chrono::milliseconds( tickMs() ) );
+			lock.unlock();
+			BlockStats poolStats; // not reported anywhere
+			g_CentralBlockPool.sweepAged( nowMs(), poolStats ); // even if threads that would sweep it are idle
+			lock.lock();
+			if ( stopRequested )
+				break;
+			uint64_t now = nowMs();
+			PurgeableRange* toDecommit = detachExpired( lists[decommit_list], now, decayMs[decommit_list].load( std::memory_order_relaxed ) );
+			PurgeableRange* toUnmap = detachExpired( lists[unmap_list], now, decayMs[unmap_list].load( std::memory_order_relaxed ) );
+			if ( toDecommit == nullptr && toUnmap == nullptr )
+				continue;
+			for ( PurgeableRange* r = toDecommit; r != nullptr; r = r->next )
+				storeMark( r->mark, purging_mark );
+			decommitInFlight = toDecommit != nullptr;
+			lock.unlock();
+			decommitRanges( toDecommit );
+			unmapRanges( toUnmap ); // nobody takes unmapped ranges back
+			lock.lock();
+			if ( decommitInFlight )
+			{
+				decommitInFlight = false;
+				purgedCv.notify_all();
+			}
+		}
+	}
+
+	static void releaseAll( RangeList& list, void (*release)( PurgeableRange* ) )
+	{
+		PurgeableRange* all = list.oldest;
+		list.oldest = nullptr;
+		list.newest = nullptr;
+		list.dirtySize = 0;
+		release( all ); // linked via next from the oldest
+	}
+
+#ifndef _MSC_VER
+	// mx is held over fork() for lists to be consistent in a child, and ranges being decommitted are purged by then
+	static void beforeFork()
+	{
+		std::unique_lock<std::mutex> lock( g_PagePurger.mx );
+		g_PagePurger.purgedCv.wait( lock, [] { return !g_PagePurger.decommitInFlight; } );
+		lock.release();
+	}
+	static void afterForkInParent() { g_PagePurger.mx.unlock(); }
+	static void afterForkInChild() { g_PagePurger.resetInChild(); }
+
+	// the only thread of a child is the forking one; the purger thread, recorded as a waiter of cv and as purger,
+	// is not there, and mx is held by the forking thread itself
+	void resetInChild()
+	{
+		new(&mx) std::mutex;
+		new(&cv) std::condition_variable;
+		new(&purgedCv) std::condition_variable;
+		new(&purger) std::thread; // dropped without joining
+		running.store( false, std::memory_order_relaxed );
+		releaseAll( lists[decommit_list], decommitRanges );
+		releaseAll( lists[unmap_list], unmapRanges );
+	}
+#endif
+
+	// the thread is created with mx released, as creating it may allocate
+	void startIfNecessary()
+	{
+		if ( decayMs[decommit_list].load( std::memory_order_relaxed ) == 0 && decayMs[unmap_list].load( std::memory_order_relaxed ) == 0 )
+			return;
+		{
+			std::lock_guard<std::mutex> lock( mx );
+			if ( running.load( std::memory_order_relaxed ) || stopRequested || purger.joinable() )
+				return;
+			running.store( true, std::memory_order_relaxed );
+		}
+		std::thread t( &PagePurger::run, this );
+		std::lock_guard<std::mutex> lock( mx );
+		purger = std::move( t );
+	}
+
+	bool add( size_t listIdx, void* range, size_t size, void* owner, uint16_t* mark )
+	{
+		assert( size >= sizeof( PurgeableRange ) );
+		if ( decayMs[listIdx].load( std::memory_order_relaxed ) == 0 || !running.load( std::memory_order_relaxed ) )
+			return false;
+		std::lock_guard<std::mutex> lock( mx );
+		if ( !running.load( std::memory_order_relaxed ) )
+			return false;
+		PurgeableRange* r = reinterpret_cast<PurgeableRange*>( range );
+		r->size = size;
+		r->freedAt = nowMs();
+		r->owner = owner;
+		r->mark = mark;
+		lists[listIdx].pushBack( r );
+		return true;
+	}
+
+public:
+	PagePurger()
+	{
+		decayMs[decommit_list].store( decayFromEnv( "IIBMALLOC_DECOMMIT_DECAY_MS" ), std::memory_order_relaxed );
+		decayMs[unmap_list].store( decayFromEnv( "IIBMALLOC_UNMAP_DECAY_MS" ), std::memory_order_relaxed );
+#ifndef _MSC_VER
+		pthread_atfork( beforeFork, afterForkInParent, afterForkInChild );
+#endif
+		startIfNecessary();
+	}
+	~PagePurger()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mx );
+			stopRequested = true;
+			running.store( false, std::memory_order_relaxed ); // ranges handed over afterwards are released by callers
+		}
+		cv.notify_one();
+		if ( purger.joinable() )
+			purger.join();
+	}
+
+	// ranges already handed over are released at the next tick according to new values
+	void setDecayTimes( size_t decommitDecayMs, size_t unmapDecayMs )
+	{
+		decayMs[decommit_list].store( decommitDecayMs, std::memory_order_relaxed );
+		decayMs[unmap_list].store( unmapDecayMs, std::memory_order_relaxed );
+		startIfNecessary();
+		cv.notify_one();
+	}
+	size_t getDecommitDecayMs() const { return decayMs[decommit_list].load( std::memory_order_relaxed ); }
+	size_t getUnmapDecayMs() const { return decayMs[unmap_list].load( std::memory_order_relaxed ); }
+
+	// returns false if the range is to be decommitted by the caller; otherwise, the purger writes purged_mark to *mark
+	// once the range is decommitted, and until then the range may be taken back with takeBack()
+	bool addForDecommit( void* range, size_t size, void* owner, uint16_t* mark )
+	{
+		return add( decommit_list, range, size, owner, mark );
+	}
+
+	// returns false if the range is to be unmapped by the caller
+	bool addForUnmap( void* range, size_t size )
+	{
+		return add( unmap_list, range, size, nullptr, nullptr );
+	}
+
+	// returns true if the range is still committed; otherwise, it has to be committed again
+	bool takeBack( void* range, const uint16_t* mark )
+	{
+		if ( loadMark( mark ) == purged_mark )
+			return false;
+		std::unique_lock<std::mutex> lock( mx );
+		if ( loadMark( mark ) == purging_mark )
+			purgedCv.wait( lock, [this] { return !decommitInFlight; } );
+		if ( loadMark( mark ) == purged_mark )
+			return false;
+		lists[decommit_list].remove( reinterpret_cast<PurgeableRange*>( range ) );
+		return true;
+	}
+
+	// to be called before the owner frees address space its ranges belong to
+	void forgetOwner( void* owner )
+	{
+		std::unique_lock<std::mutex> lock( mx );
+		purgedCv.wait( lock, [this] { return !decommitInFlight; } ); // marks of ranges being decommitted are still to be written
+		RangeList& list = lists[decommit_list];
+		PurgeableRange* next;
+		for ( PurgeableRange* r = list.oldest; r != nullptr; r = next )
+		{
+			next = r->next;
+			if ( r->owner == owner )
+				list.remove( r );
+		}
+	}
+};
+
+#endif // PAGE_PURGER_H
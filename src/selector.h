@@ -35,6 +35,7 @@
 #ifndef SELECTOR_H
 #define SELECTOR_H
 
+// an allocator tested when no allocators are given in a command line (see main())
 // TODO:
 // (1) #include "my_allocator.h"
 // (2) define MyAllocatorT properly
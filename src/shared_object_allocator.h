@@ -0,0 +1,105 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- allocator loaded from a shared object
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#ifndef SHARED_OBJECT_ALLOCATOR_H
+#define SHARED_OBJECT_ALLOCATOR_H
+
+#include "test_common.h"
+
+#ifndef _MSC_VER
+#include <dlfcn.h>
+#endif
+
+// malloc()/free() of a shared object (e.g. libjemalloc.so or libtcmalloc_minimal.so) loaded into a separate
+// link-map namespace, so that neither the tester itself nor other allocators are affected by it;
+// only one shared object may be loaded in a process
+class SharedObjectAllocatorForTest
+{
+	ThreadTestRes* testRes;
+
+	typedef void* (*MallocFn)( size_t );
+	typedef void (*FreeFn)( void* );
+	static inline MallocFn mallocFn = nullptr;
+	static inline FreeFn freeFn = nullptr;
+	static inline char soName[256] = {};
+
+public:
+	SharedObjectAllocatorForTest( ThreadTestRes* testRes_ ) { testRes = testRes_; }
+	static constexpr bool isFake() { return false; }
+
+	static const char* name() { return soName; }
+
+	static bool load( const char* path )
+	{
+		assert( mallocFn == nullptr );
+		const char* baseName = strrchr( path, '/' );
+		snprintf( soName, sizeof( soName ), "%s", baseName ? baseName + 1 : path );
+#ifdef _MSC_VER
+		printf( "loading allocators from shared objects is not supported on this platform (\'%s\')\n", path );
+		return false;
+#else
+		void* handle = dlmopen( LM_ID_NEWLM, path, RTLD_NOW | RTLD_LOCAL );
+		if ( handle == nullptr )
+		{
+			printf( "failed to load \'%s\' (%s)\n", path, dlerror() );
+			return false;
+		}
+		mallocFn = reinterpret_cast<MallocFn>( dlsym( handle, "malloc" ) );
+		freeFn = reinterpret_cast<FreeFn>( dlsym( handle, "free" ) );
+		if ( mallocFn == nullptr || freeFn == nullptr )
+		{
+			printf( "\'%s\' does not export malloc() and free()\n", path );
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	void init() { assert( mallocFn != nullptr ); }
+	void* allocate( size_t sz ) { return mallocFn( sz ); }
+	void deallocate( void* ptr ) { freeFn( ptr ); }
+	void deinit() {}
+
+	// next calls are to get additional stats of the allocator, etc, if desired
+	void doWhateverAfterSetupPhase() {}
+	void doWhateverAfterMainLoopPhase() {}
+	void doWhateverAfterCleanupPhase() {}
+
+	ThreadTestRes* getTestRes() { return testRes; }
+};
+
+
+
+
+#endif // SHARED_OBJECT_ALLOCATOR_H
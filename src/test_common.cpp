@@ -36,6 +36,9 @@
 
 #include <stdint.h>
 #include <assert.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
 
 #ifdef _MSC_VER
 #include <Windows.h>
@@ -131,3 +134,138 @@ size_t getRss()
 }
 #endif
 
+
+
+#ifdef _MSC_VER
+void capturePerfCounters( ThreadTestRes* res, TEST_POINT point )
+{
+	// not implemented
+	res->perfCountersAvailable = 0;
+	memset( res->perfAt + point, 0, sizeof( PerfCounterValues ) );
+}
+#else
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct PerfEventDesc
+{
+	uint32_t type;
+	uint64_t config;
+};
+
+static const PerfEventDesc perfEvents[perf_counter_count] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+};
+
+struct ThreadPerfCounters
+{
+	int fds[perf_counter_count];
+	uint32_t available;
+	bool rusageFallback; // page faults and task clock from getrusage()
+};
+
+static thread_local ThreadPerfCounters threadPerfCounters;
+
+static int openPerfEvent( const PerfEventDesc& desc, int groupFd )
+{
+	struct perf_event_attr attr;
+	memset( &attr, 0, sizeof( attr ) );
+	attr.size = sizeof( attr );
+	attr.type = desc.type;
+	attr.config = desc.config;
+	attr.exclude_hv = 1;
+	int fd = syscall( __NR_perf_event_open, &attr, 0, -1, groupFd, 0 ); // calling thread, any CPU
+	if ( fd == -1 && ( errno == EACCES || errno == EPERM ) )
+	{
+		attr.exclude_kernel = 1; // perf_event_paranoid >= 2
+		fd = syscall( __NR_perf_event_open, &attr, 0, -1, groupFd, 0 );
+	}
+	return fd;
+}
+
+static void openPerfCounters( ThreadPerfCounters& pc )
+{
+	pc.available = 0;
+	pc.rusageFallback = false;
+	int groupFd = -1; // hardware events are grouped to be scheduled together
+	for ( size_t i=0; i<perf_counter_count; ++i )
+	{
+		bool hardware = perfEvents[i].type != PERF_TYPE_SOFTWARE;
+		pc.fds[i] = openPerfEvent( perfEvents[i], hardware ? groupFd : -1 );
+		if ( pc.fds[i] == -1 )
+			continue;
+		pc.available |= 1 << i;
+		if ( hardware && groupFd == -1 )
+			groupFd = pc.fds[i];
+	}
+	if ( ( pc.available & ( ( 1 << perf_page_faults ) | ( 1 << perf_task_clock_ns ) ) ) == 0 )
+	{
+		pc.rusageFallback = true;
+		pc.available |= ( 1 << perf_page_faults ) | ( 1 << perf_task_clock_ns );
+	}
+}
+
+static void closePerfCounters( ThreadPerfCounters& pc )
+{
+	for ( size_t i=0; i<perf_counter_count; ++i )
+		if ( pc.fds[i] != -1 )
+			close( pc.fds[i] );
+}
+
+void capturePerfCounters( ThreadTestRes* res, TEST_POINT point )
+{
+	ThreadPerfCounters& pc = threadPerfCounters;
+	if ( point == test_point_begin )
+		openPerfCounters( pc );
+
+	PerfCounterValues& values = res->perfAt[point];
+	memset( &values, 0, sizeof( values ) );
+	for ( size_t i=0; i<perf_counter_count; ++i )
+		if ( pc.fds[i] != -1 && read( pc.fds[i], values.values + i, sizeof( uint64_t ) ) != sizeof( uint64_t ) )
+			values.values[i] = 0;
+	if ( pc.rusageFallback )
+	{
+		struct rusage ru;
+		if ( getrusage( RUSAGE_THREAD, &ru ) == 0 )
+		{
+			values.values[perf_page_faults] = ru.ru_minflt + ru.ru_majflt;
+			values.values[perf_task_clock_ns] = ( ru.ru_utime.tv_sec + ru.ru_stime.tv_sec ) * 1000000000ull + ( ru.ru_utime.tv_usec + ru.ru_stime.tv_usec ) * 1000ull;
+		}
+	}
+	res->perfCountersAvailable = pc.available;
+
+	if ( point == test_point_exit )
+		closePerfCounters( pc );
+}
+#endif
+
+void idleAfterMainLoop( ThreadTestRes* res, size_t idleMs )
+{
+	memset( res->rssDuringIdle, 0, sizeof( res->rssDuringIdle ) );
+	res->idleDur = 0;
+	if ( idleMs )
+	{
+		size_t start = GetMillisecondCount();
+		res->rssDuringIdle[0] = getRss();
+		for ( size_t i=1; i<idle_rss_sample_count; ++i )
+		{
+			size_t sampleAt = start + idleMs * i / ( idle_rss_sample_count - 1 );
+			size_t now = GetMillisecondCount();
+			if ( now < sampleAt )
+				std::this_thread::sleep_for( std::chrono::milliseconds( sampleAt - now ) );
+			res->rssDuringIdle[i] = getRss();
+		}
+		res->idleDur = GetMillisecondCount() - start;
+	}
+	res->rdtscIdle = __rdtsc();
+	capturePerfCounters( res, test_point_idle );
+}
@@ -65,45 +65,235 @@ size_t getRss();
 
 constexpr size_t max_threads = 32;
 
+// a set of numbers of threads to run a test with
+class ThreadCountSet
+{
+	uint64_t mask = 0;
+	static_assert( max_threads <= 64, "" );
+
+	static size_t lowestBit( uint64_t x )
+	{
+		size_t ret = 0;
+		for ( ; ( x & 1 ) == 0; x >>= 1 )
+			++ret;
+		return ret;
+	}
+
+public:
+	static ThreadCountSet only( size_t threadCount ) { ThreadCountSet ret; ret.add( threadCount ); return ret; }
+	void add( size_t threadCount ) { assert( threadCount < max_threads ); mask |= 1ull << threadCount; }
+	void addRange( size_t from, size_t to ) { for ( size_t i=from; i<=to; ++i ) add( i ); }
+	void removeAbove( size_t threadCount ) { if ( threadCount < 63 ) mask &= ( 2ull << threadCount ) - 1; }
+	bool empty() const { return mask == 0; }
+	uint64_t asMask() const { return mask; }
+
+	struct Iterator
+	{
+		uint64_t rest;
+		size_t operator*() const { return lowestBit( rest ); }
+		Iterator& operator++() { rest &= rest - 1; return *this; }
+		bool operator!=( const Iterator& other ) const { return rest != other.rest; }
+	};
+	Iterator begin() const { return { mask }; }
+	Iterator end() const { return { 0 }; }
+};
+
 enum MEM_ACCESS_TYPE { none, single, full, check };
+enum TEST_TYPE { random_pos_random_size, producer_consumer, trace_replay, fast_path, load_shift, thread_churn };
+
+constexpr size_t pareto_min_item_count = 7; // random_pos_random_size picks items from 7 Pareto ranges (see Pareto_80_20_6_Init())
 
 #define COLLECT_USER_MAX_ALLOCATED
 
+// log-linear histogram (in the spirit of HdrHistogram): values below 2^sub_bucket_bits are counted exactly,
+// each further power of two is split into 2^sub_bucket_bits equal sub-buckets (that is, ~6% precision)
+struct LatencyHistogram
+{
+	static constexpr size_t sub_bucket_bits = 4;
+	static constexpr size_t sub_bucket_cnt = 1 << sub_bucket_bits;
+	static constexpr size_t bucket_cnt = (64 - sub_bucket_bits + 1) << sub_bucket_bits;
+
+	uint64_t counts[bucket_cnt];
+	uint64_t totalCount;
+	uint64_t maxVal;
+
+	static FORCE_INLINE size_t valueToBucket( uint64_t val )
+	{
+		if ( val < sub_bucket_cnt )
+			return (size_t)val;
+#if _MSC_VER
+		unsigned long msb;
+		_BitScanReverse64( &msb, val );
+#elif __GNUC__
+		size_t msb = 63 - __builtin_clzll( val );
+#else
+		static_assert(false, "Unknown compiler");
+#endif
+		size_t shift = msb - sub_bucket_bits;
+		return ( ( shift + 1 ) << sub_bucket_bits ) + ( ( val >> shift ) & ( sub_bucket_cnt - 1 ) );
+	}
+	static uint64_t bucketToLowestValue( size_t bucket )
+	{
+		if ( bucket < sub_bucket_cnt )
+			return bucket;
+		size_t shift = ( bucket >> sub_bucket_bits ) - 1;
+		return ( sub_bucket_cnt + ( bucket & ( sub_bucket_cnt - 1 ) ) ) << shift;
+	}
+
+	FORCE_INLINE void record( uint64_t val )
+	{
+		++counts[ valueToBucket( val ) ];
+		++totalCount;
+		if ( maxVal < val )
+			maxVal = val;
+	}
+
+	void merge( const LatencyHistogram& other )
+	{
+		for ( size_t i=0; i<bucket_cnt; ++i )
+			counts[i] += other.counts[i];
+		totalCount += other.totalCount;
+		if ( maxVal < other.maxVal )
+			maxVal = other.maxVal;
+	}
+
+	uint64_t valueAtPercentile( double percentile ) const // returns the highest value equivalent to that at a given percentile
+	{
+		if ( totalCount == 0 )
+			return 0;
+		uint64_t countAtPercentile = (uint64_t)( percentile / 100. * totalCount + 0.5 );
+		if ( countAtPercentile == 0 )
+			countAtPercentile = 1;
+		uint64_t cumulative = 0;
+		for ( size_t i=0; i<bucket_cnt; ++i )
+		{
+			cumulative += counts[i];
+			if ( cumulative >= countAtPercentile )
+			{
+				uint64_t highest = i + 1 < bucket_cnt ? bucketToLowestValue( i + 1 ) - 1 : UINT64_MAX;
+				return highest < maxVal ? highest : maxVal;
+			}
+		}
+		return maxVal;
+	}
+};
+
+struct LatencyPercentiles // in CPU ticks (as per __rdtsc())
+{
+	uint64_t opCount;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t p9999;
+	uint64_t max;
+
+	void set( const LatencyHistogram& h )
+	{
+		opCount = h.totalCount;
+		p50 = h.valueAtPercentile( 50 );
+		p99 = h.valueAtPercentile( 99 );
+		p999 = h.valueAtPercentile( 99.9 );
+		p9999 = h.valueAtPercentile( 99.99 );
+		max = h.maxVal;
+	}
+};
+
+// per-thread performance counters read at points where rdtsc* of ThreadTestRes are captured;
+// hardware events are unavailable, for instance, in VMs or under perf_event_paranoid restrictions,
+// while page faults and task clock fall back to software events and then to getrusage()
+enum PERF_COUNTER { perf_cycles, perf_instructions, perf_cache_misses, perf_dtlb_misses, perf_branch_misses, perf_page_faults, perf_task_clock_ns, perf_counter_count };
+constexpr const char* perf_counter_names[perf_counter_count] = { "cycles", "instructions", "cache misses", "dTLB misses", "branch misses", "page faults", "task clock(ns)" };
+
+enum TEST_POINT { test_point_begin, test_point_setup, test_point_main_loop, test_point_idle, test_point_exit, test_point_count };
+constexpr size_t test_phase_count = test_point_count - 1; // phase N is between points N and N+1
+constexpr const char* test_phase_names[test_phase_count] = { "setup", "main loop", "idle", "exit" };
+
+// RSS is sampled evenly over the idle phase, including its start and end
+constexpr size_t idle_rss_sample_count = 9;
+
+struct PerfCounterValues
+{
+	uint64_t values[perf_counter_count];
+};
+
+struct ThreadTestRes;
+void capturePerfCounters( ThreadTestRes* res, TEST_POINT point ); // counters are opened at test_point_begin and closed at test_point_exit
+
 struct ThreadTestRes
 {
 	size_t threadID;
+	uint64_t rngSeed; // of the thread itself, derived from TestStartupParams::rndSeed and threadID
 
 	size_t innerDur;
 
 	uint64_t rdtscBegin;
 	uint64_t rdtscSetup;
 	uint64_t rdtscMainLoop;
+	uint64_t rdtscIdle;
 	uint64_t rdtscExit;
 
+	size_t idleDur; // ms; not included into innerDur
+	size_t rssDuringIdle[idle_rss_sample_count]; // process-wide, as seen by the thread
+	size_t rssAfterTurn; // load_shift only: process-wide, once the thread has deallocated all of its items
+
 	size_t rssMax;
 	size_t allocatedAfterSetupSz;
 #ifdef COLLECT_USER_MAX_ALLOCATED
 	size_t allocatedMax;
 #endif
+
+	// per-operation latencies; non-null only if requested by TestStartupParams::collectOpLatencies
+	LatencyHistogram* allocLatency;
+	LatencyHistogram* deallocLatency;
+
+	uint32_t perfCountersAvailable; // bitmask over PERF_COUNTER
+	PerfCounterValues perfAt[test_point_count];
+	size_t mainLoopOpCount; // allocations and deallocations, to normalize counters per operation
 };
 
+// idle phase, if any, follows the main loop; the point is captured anyway
+void idleAfterMainLoop( ThreadTestRes* res, size_t idleMs );
+
+inline
+uint64_t perfCounterPhaseValue( const ThreadTestRes& res, size_t phase, size_t counter )
+{
+	return res.perfAt[phase + 1].values[counter] - res.perfAt[phase].values[counter];
+}
+
 inline
 void printThreadStats( const char* prefix, ThreadTestRes& res )
 {
 	uint64_t rdtscTotal = res.rdtscExit - res.rdtscBegin;
-	printf( "%s%zd: %zdms; %zd (%.2f | %.2f | %.2f);\n", prefix, res.threadID, res.innerDur, rdtscTotal, (res.rdtscSetup - res.rdtscBegin) * 100. / rdtscTotal, (res.rdtscMainLoop - res.rdtscSetup) * 100. / rdtscTotal, (res.rdtscExit - res.rdtscMainLoop) * 100. / rdtscTotal );
+	printf( "%s%zd: %zdms; %zd (%.2f | %.2f | %.2f | %.2f);\n", prefix, res.threadID, res.innerDur, rdtscTotal, (res.rdtscSetup - res.rdtscBegin) * 100. / rdtscTotal, (res.rdtscMainLoop - res.rdtscSetup) * 100. / rdtscTotal, (res.rdtscIdle - res.rdtscMainLoop) * 100. / rdtscTotal, (res.rdtscExit - res.rdtscIdle) * 100. / rdtscTotal );
+	for ( size_t c=0; c<perf_counter_count; ++c )
+		if ( res.perfCountersAvailable & ( 1 << c ) )
+			printf( "%s    %s: %zd | %zd | %zd | %zd\n", prefix, perf_counter_names[c], (size_t)perfCounterPhaseValue( res, 0, c ), (size_t)perfCounterPhaseValue( res, 1, c ), (size_t)perfCounterPhaseValue( res, 2, c ), (size_t)perfCounterPhaseValue( res, 3, c ) );
+	if ( res.idleDur )
+	{
+		printf( "%s    idle for %zdms, RSS (pages):", prefix, res.idleDur );
+		for ( size_t i=0; i<idle_rss_sample_count; ++i )
+			printf( " %zd", res.rssDuringIdle[i] );
+		printf( "\n" );
+	}
 }
 
 struct TestRes
 {
+	size_t threadCount; // including consumers, if any
 	size_t duration;
 	size_t cumulativeDuration;
+	size_t rssBeforeTest;
 	size_t rssMax;
 	size_t allocatedAfterSetupSz;
 	size_t rssAfterExitingAllThreads;
 #ifdef COLLECT_USER_MAX_ALLOCATED
 	size_t allocatedMax;
 #endif
+	LatencyPercentiles allocLatency; // merged over all threads
+	LatencyPercentiles deallocLatency;
+	uint32_t perfCountersAvailable; // on all threads
+	PerfCounterValues perfPhase[test_phase_count]; // summed over all threads
+	size_t mainLoopOpCount;
 	ThreadTestRes threadRes[max_threads];
 };
 
@@ -115,6 +305,16 @@ struct TestStartupParams
 	size_t iterCount;
 	MEM_ACCESS_TYPE mat;
 	size_t  rndSeed;
+	bool collectOpLatencies; // random_pos_random_size only
+	size_t idleAfterMainLoopMs; // random_pos_random_size only: threads sleep with all items allocated, to see memory being returned over time
+	TEST_TYPE testType;
+	// producer_consumer only: threadCount is a number of producers; items are handed off to consumers
+	size_t consumerThreadCount;
+	size_t handoffPercent; // share of allocated items to be deallocated by consumers
+	size_t handoffBatchSize; // items per a single ring operation
+	bool handoffViaSharedRing; // a single MPMC ring instead of SPSC ring per producer/consumer pair
+	// trace_replay only: threadCount is ignored and a number of threads in a trace is used instead
+	const char* traceFileName;
 };
 
 struct TestStartupParamsAndResults
@@ -123,11 +323,18 @@ struct TestStartupParamsAndResults
 	TestRes* testRes;
 };
 
+struct HandoffContext;
+struct TraceReplayContext;
+struct LoadShiftContext;
+
 struct ThreadStartupParamsAndResults
 {
 	TestStartupParams startupParams;
 	size_t threadID;
 	ThreadTestRes* threadRes;
+	HandoffContext* handoffContext; // producer_consumer only
+	TraceReplayContext* traceReplayContext; // trace_replay only
+	LoadShiftContext* loadShiftContext; // load_shift only
 };
 
 
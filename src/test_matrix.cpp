@@ -0,0 +1,400 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- a test matrix defined by a command line and configuration files
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#include "test_matrix.h"
+
+#include <string>
+
+
+void TestMatrix::getPoint( size_t idx, TestStartupParams& params ) const
+{
+	params = base;
+	params.rndSeed = rndSeeds[ idx % rndSeeds.size() ];
+	idx /= rndSeeds.size();
+	params.mat = mats[ idx % mats.size() ];
+	idx /= mats.size();
+	params.iterCount = iterCounts[ idx % iterCounts.size() ];
+	idx /= iterCounts.size();
+	params.maxItems = maxItemCounts[ idx % maxItemCounts.size() ];
+	idx /= maxItemCounts.size();
+	params.maxItemSize = maxItemSizeExps[ idx % maxItemSizeExps.size() ];
+}
+
+void initTestMatrix( TestMatrix& matrix )
+{
+	memset( &(matrix.base), 0, sizeof( matrix.base ) );
+	matrix.base.collectOpLatencies = false;
+	matrix.base.idleAfterMainLoopMs = 0;
+	matrix.base.testType = TEST_TYPE::random_pos_random_size;
+	matrix.base.consumerThreadCount = 2; // producer_consumer only, as well as parameters below
+	matrix.base.handoffPercent = 50;
+	matrix.base.handoffBatchSize = 16;
+	matrix.base.handoffViaSharedRing = false;
+	matrix.base.traceFileName = "alloc.trace"; // trace_replay only
+
+	matrix.threadCounts = ThreadCountSet();
+	matrix.threadCounts.addRange( 1, 23 );
+	matrix.maxItemSizeExps = { 16 };
+	matrix.maxItemCounts = { 1 << 25 };
+	matrix.iterCounts = { 100000000 };
+	matrix.mats = { MEM_ACCESS_TYPE::full };
+	matrix.rndSeeds = { 0 };
+	matrix.allocators.clear();
+	matrix.resultsFileName = nullptr;
+	matrix.outDir = nullptr;
+}
+
+
+// values
+
+static const char* copyString( const char* str, size_t len ) // lives until exit
+{
+	char* ret = new char[ len + 1 ];
+	memcpy( ret, str, len );
+	ret[len] = 0;
+	return ret;
+}
+
+// comma-separated items; spaces around items are ignored
+template<class ItemFn>
+static bool forEachListItem( const char* value, ItemFn fn )
+{
+	const char* pos = value;
+	for (;;)
+	{
+		while ( *pos == ' ' || *pos == '\t' )
+			++pos;
+		const char* end = pos;
+		while ( *end != 0 && *end != ',' )
+			++end;
+		const char* itemEnd = end;
+		while ( itemEnd > pos && ( itemEnd[-1] == ' ' || itemEnd[-1] == '\t' ) )
+			--itemEnd;
+		if ( itemEnd == pos || !fn( std::string( pos, itemEnd - pos ) ) )
+			return false;
+		if ( *end == 0 )
+			return true;
+		pos = end + 1;
+	}
+}
+
+// a number with an optional binary suffix (k, M, G)
+static bool parseSize( const std::string& str, size_t& ret )
+{
+	char* end;
+	unsigned long long val = strtoull( str.c_str(), &end, 10 );
+	if ( end == str.c_str() )
+		return false;
+	switch ( *end )
+	{
+		case 'k': case 'K': val <<= 10; ++end; break;
+		case 'm': case 'M': val <<= 20; ++end; break;
+		case 'g': case 'G': val <<= 30; ++end; break;
+	}
+	ret = (size_t)val;
+	return *end == 0;
+}
+
+// a list of numbers and ranges like 1-8,12,16
+template<class NumberFn>
+static bool parseNumberList( const char* value, NumberFn fn )
+{
+	return forEachListItem( value, [&]( const std::string& item ) {
+		size_t dash = item.find( '-' );
+		size_t from, to;
+		if ( dash == std::string::npos )
+		{
+			if ( !parseSize( item, from ) )
+				return false;
+			to = from;
+		}
+		else if ( !parseSize( item.substr( 0, dash ), from ) || !parseSize( item.substr( dash + 1 ), to ) || to < from )
+			return false;
+		for ( size_t i=from; i<=to; ++i )
+			if ( !fn( i ) )
+				return false;
+		return true;
+	} );
+}
+
+static bool parseSizeList( const char* value, std::vector<size_t>& list )
+{
+	list.clear();
+	return parseNumberList( value, [&]( size_t n ) { list.push_back( n ); return true; } );
+}
+
+static bool parseBool( const char* value, bool& ret )
+{
+	if ( *value == 0 || strcmp( value, "1" ) == 0 || strcmp( value, "yes" ) == 0 || strcmp( value, "true" ) == 0 )
+		ret = true;
+	else if ( strcmp( value, "0" ) == 0 || strcmp( value, "no" ) == 0 || strcmp( value, "false" ) == 0 )
+		ret = false;
+	else
+		return false;
+	return true;
+}
+
+
+// options (the same in a command line, as --<name> <value>, and in a configuration file, as <name> = <value>)
+
+struct TestMatrixOption
+{
+	const char* name;
+	bool isFlag; // takes no value in a command line
+	const char* help;
+};
+
+static const TestMatrixOption testMatrixOptions[] = {
+	{ "config", false, "<file>: read options from a file with lines like 'threads = 1-8' ('#' starts a comment)" },
+	{ "test", false, "random_pos_random_size | producer_consumer | trace_replay | fast_path | load_shift | thread_churn" },
+	{ "threads", false, "<list>: numbers of threads (of producers for producer_consumer), e.g. 1-8,12,16" },
+	{ "size-exp", false, "<list>: exponents of max item sizes" },
+	{ "items", false, "<list>: max numbers of items for all threads together (of each thread for load_shift), k/M/G suffixes are allowed" },
+	{ "iterations", false, "<list>: numbers of iterations of each thread, k/M/G suffixes are allowed" },
+	{ "mat", false, "<list>: memory access modes, any of none, single, full, check" },
+	{ "seeds", false, "<list>: random seeds" },
+	{ "latencies", true, "collect per-operation latencies (random_pos_random_size only)" },
+	{ "idle-ms", false, "<n>: sleep with all items allocated after the main loop, sampling RSS (random_pos_random_size only)" },
+	{ "consumers", false, "<n>: number of consumer threads (producer_consumer only)" },
+	{ "handoff-percent", false, "<n>: share of items deallocated by consumers (producer_consumer only)" },
+	{ "handoff-batch", false, "<n>: items per ring operation (producer_consumer only)" },
+	{ "shared-ring", true, "a single MPMC ring instead of SPSC rings (producer_consumer only)" },
+	{ "trace", false, "<file>: a trace to replay (trace_replay only)" },
+	{ "allocators", false, "<list>: allocators to test, the same as positional arguments" },
+	{ "results", false, "<file.json>: write results of all points to a single file" },
+	{ "out", false, "<dir>: write results to a file per point and allocator, skipping points already there" },
+};
+
+static bool setOption( TestMatrix& matrix, const char* name, const char* value, bool persistValue )
+{
+	TestStartupParams& base = matrix.base;
+	bool ok = true;
+	if ( strcmp( name, "config" ) == 0 )
+		return parseTestMatrixConfig( matrix, value );
+	else if ( strcmp( name, "test" ) == 0 )
+	{
+		if ( strcmp( value, "random_pos_random_size" ) == 0 )
+			base.testType = TEST_TYPE::random_pos_random_size;
+		else if ( strcmp( value, "producer_consumer" ) == 0 )
+			base.testType = TEST_TYPE::producer_consumer;
+		else if ( strcmp( value, "trace_replay" ) == 0 )
+			base.testType = TEST_TYPE::trace_replay;
+		else if ( strcmp( value, "fast_path" ) == 0 )
+			base.testType = TEST_TYPE::fast_path;
+		else if ( strcmp( value, "load_shift" ) == 0 )
+			base.testType = TEST_TYPE::load_shift;
+		else if ( strcmp( value, "thread_churn" ) == 0 )
+			base.testType = TEST_TYPE::thread_churn;
+		else
+			ok = false;
+	}
+	else if ( strcmp( name, "threads" ) == 0 )
+	{
+		matrix.threadCounts = ThreadCountSet();
+		ok = parseNumberList( value, [&]( size_t n ) { if ( n == 0 || n >= max_threads ) return false; matrix.threadCounts.add( n ); return true; } );
+	}
+	else if ( strcmp( name, "size-exp" ) == 0 )
+	{
+		matrix.maxItemSizeExps.clear();
+		ok = parseNumberList( value, [&]( size_t n ) { if ( n == 0 || n >= 32 ) return false; matrix.maxItemSizeExps.push_back( n ); return true; } );
+	}
+	else if ( strcmp( name, "items" ) == 0 )
+		ok = parseSizeList( value, matrix.maxItemCounts );
+	else if ( strcmp( name, "iterations" ) == 0 )
+		ok = parseSizeList( value, matrix.iterCounts );
+	else if ( strcmp( name, "mat" ) == 0 )
+	{
+		matrix.mats.clear();
+		ok = forEachListItem( value, [&]( const std::string& item ) {
+			if ( item == "none" )
+				matrix.mats.push_back( MEM_ACCESS_TYPE::none );
+			else if ( item == "single" )
+				matrix.mats.push_back( MEM_ACCESS_TYPE::single );
+			else if ( item == "full" )
+				matrix.mats.push_back( MEM_ACCESS_TYPE::full );
+			else if ( item == "check" )
+				matrix.mats.push_back( MEM_ACCESS_TYPE::check );
+			else
+				return false;
+			return true;
+		} );
+	}
+	else if ( strcmp( name, "seeds" ) == 0 )
+		ok = parseSizeList( value, matrix.rndSeeds );
+	else if ( strcmp( name, "latencies" ) == 0 )
+		ok = parseBool( value, base.collectOpLatencies );
+	else if ( strcmp( name, "idle-ms" ) == 0 )
+		ok = parseSize( value, base.idleAfterMainLoopMs );
+	else if ( strcmp( name, "consumers" ) == 0 )
+		ok = parseSize( value, base.consumerThreadCount ) && base.consumerThreadCount > 0 && base.consumerThreadCount < max_threads;
+	else if ( strcmp( name, "handoff-percent" ) == 0 )
+		ok = parseSize( value, base.handoffPercent ) && base.handoffPercent <= 100;
+	else if ( strcmp( name, "handoff-batch" ) == 0 )
+		ok = parseSize( value, base.handoffBatchSize ) && base.handoffBatchSize > 0;
+	else if ( strcmp( name, "shared-ring" ) == 0 )
+		ok = parseBool( value, base.handoffViaSharedRing );
+	else if ( strcmp( name, "trace" ) == 0 )
+		base.traceFileName = persistValue ? copyString( value, strlen( value ) ) : value;
+	else if ( strcmp( name, "allocators" ) == 0 )
+		ok = forEachListItem( value, [&]( const std::string& item ) { matrix.allocators.push_back( copyString( item.c_str(), item.size() ) ); return true; } );
+	else if ( strcmp( name, "results" ) == 0 )
+		matrix.resultsFileName = persistValue ? copyString( value, strlen( value ) ) : value;
+	else if ( strcmp( name, "out" ) == 0 )
+		matrix.outDir = persistValue ? copyString( value, strlen( value ) ) : value;
+	else
+	{
+		printf( "unknown option \'%s\'\n", name );
+		return false;
+	}
+	if ( !ok )
+		printf( "invalid value \'%s\' of option \'%s\'\n", value, name );
+	return ok;
+}
+
+static const TestMatrixOption* findOption( const char* name )
+{
+	for ( size_t i=0; i<sizeof(testMatrixOptions)/sizeof(testMatrixOptions[0]); ++i )
+		if ( strcmp( name, testMatrixOptions[i].name ) == 0 )
+			return testMatrixOptions + i;
+	return nullptr;
+}
+
+bool parseTestMatrixArgs( TestMatrix& matrix, int argc, char** argv )
+{
+	for ( int i=1; i<argc; ++i )
+	{
+		if ( strncmp( argv[i], "--", 2 ) != 0 )
+		{
+			matrix.allocators.push_back( argv[i] );
+			continue;
+		}
+		const char* name = argv[i] + 2;
+		const TestMatrixOption* option = findOption( name );
+		if ( option == nullptr )
+		{
+			printf( "unknown option \'%s\'\n", argv[i] );
+			return false;
+		}
+		if ( !option->isFlag && i + 1 == argc )
+		{
+			printf( "option \'%s\' requires a value\n", argv[i] );
+			return false;
+		}
+		if ( !setOption( matrix, name, option->isFlag ? "" : argv[++i], false ) )
+			return false;
+	}
+	return true;
+}
+
+bool parseTestMatrixConfig( TestMatrix& matrix, const char* fileName )
+{
+	FILE* f = fopen( fileName, "r" );
+	if ( f == nullptr )
+	{
+		printf( "failed to open \'%s\'\n", fileName );
+		return false;
+	}
+	char line[4096];
+	size_t lineNum = 0;
+	bool ok = true;
+	while ( ok && fgets( line, sizeof( line ), f ) != nullptr )
+	{
+		++lineNum;
+		char* comment = strchr( line, '#' );
+		if ( comment )
+			*comment = 0;
+		char* end = line + strlen( line );
+		while ( end > line && ( end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t' ) )
+			*--end = 0;
+		char* name = line;
+		while ( *name == ' ' || *name == '\t' )
+			++name;
+		if ( *name == 0 )
+			continue;
+		char* value = name;
+		while ( *value != 0 && *value != '=' && *value != ' ' && *value != '\t' )
+			++value;
+		char* nameEnd = value;
+		while ( *value == ' ' || *value == '\t' || *value == '=' )
+			++value;
+		*nameEnd = 0;
+		ok = setOption( matrix, name, value, true );
+		if ( !ok )
+			printf( "\tat %s:%zd\n", fileName, lineNum );
+	}
+	fclose( f );
+	return ok;
+}
+
+// as split by runTestSeries()
+static size_t minItemsPerThread( TEST_TYPE testType )
+{
+	switch ( testType )
+	{
+		case TEST_TYPE::random_pos_random_size: return pareto_min_item_count;
+		case TEST_TYPE::producer_consumer: return 1;
+		case TEST_TYPE::load_shift: return 1;
+		case TEST_TYPE::thread_churn: return 1; // items are replaced at random
+		default: return 0; // items are not indexed (at least one fast_path slot is used anyway)
+	}
+}
+
+bool checkItemsPerThread( const TestMatrix& matrix, ThreadCountSet threadCounts )
+{
+	size_t minItems = minItemsPerThread( matrix.base.testType );
+	bool ok = true;
+	for ( size_t maxItems : matrix.maxItemCounts )
+		for ( size_t threadCount : threadCounts )
+		{
+			size_t itemsPerThread = matrix.base.testType == TEST_TYPE::load_shift ? maxItems : maxItems / threadCount;
+			if ( itemsPerThread < minItems )
+			{
+				printf( "%zd items for %zd threads are too few (at least %zd per thread are needed for this test)\n", maxItems, threadCount, minItems );
+				ok = false;
+			}
+		}
+	return ok;
+}
+
+void printTestMatrixUsage()
+{
+	printf( "usage: allocator_tester [options] [allocator ...]\n" );
+	printf( "   allocator: a built-in one ('new-delete', 'iibmalloc'), a path to a shared object exporting malloc() and free(),\n" );
+	printf( "      or a directory with such shared objects; if none is given, an allocator defined in selector.h is tested\n" );
+	printf( "   options (lists are comma-separated; each combination of their values is tested):\n" );
+	for ( size_t i=0; i<sizeof(testMatrixOptions)/sizeof(testMatrixOptions[0]); ++i )
+		printf( "      --%s %s\n", testMatrixOptions[i].name, testMatrixOptions[i].help );
+	printf( "usage: allocator_tester --compare <base> <new> [threshold(%%), 5 by default]\n" );
+	printf( "   base and new are result files or directories of them; exit code is 1 if any regressions are found\n" );
+}
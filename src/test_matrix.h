@@ -0,0 +1,66 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- a test matrix defined by a command line and configuration files
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#ifndef ALLOCATOR_TEST_MATRIX_H
+#define ALLOCATOR_TEST_MATRIX_H
+
+#include "test_common.h"
+#include <vector>
+
+// each combination of swept values is a point of a matrix; each point is run for all thread counts and all allocators
+struct TestMatrix
+{
+	TestStartupParams base; // values that are not swept
+	ThreadCountSet threadCounts;
+	std::vector<size_t> maxItemSizeExps;
+	std::vector<size_t> maxItemCounts; // totals for all threads
+	std::vector<size_t> iterCounts;
+	std::vector<MEM_ACCESS_TYPE> mats;
+	std::vector<size_t> rndSeeds;
+	std::vector<const char*> allocators; // as specified; if empty, an allocator defined in selector.h is used
+
+	const char* resultsFileName = nullptr; // all results in a single file
+	const char* outDir = nullptr; // a file per point and allocator; points with existing files are skipped
+
+	size_t pointCount() const { return maxItemSizeExps.size() * maxItemCounts.size() * iterCounts.size() * mats.size() * rndSeeds.size(); }
+	void getPoint( size_t idx, TestStartupParams& params ) const; // params.maxItems is a total for all threads
+};
+
+void initTestMatrix( TestMatrix& matrix ); // current defaults
+bool parseTestMatrixArgs( TestMatrix& matrix, int argc, char** argv ); // prints a reason on failure
+bool parseTestMatrixConfig( TestMatrix& matrix, const char* fileName );
+bool checkItemsPerThread( const TestMatrix& matrix, ThreadCountSet threadCounts ); // prints a reason on failure
+void printTestMatrixUsage();
+
+#endif // ALLOCATOR_TEST_MATRIX_H
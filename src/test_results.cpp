@@ -0,0 +1,672 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- machine-readable results and their comparison
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#include "test_results.h"
+
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#else
+#include <sys/utsname.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+
+// writing
+
+static void writeJsonString( FILE* f, const char* str )
+{
+	fputc( '\"', f );
+	for ( const char* c = str ? str : ""; *c; ++c )
+	{
+		if ( *c == '\"' || *c == '\\' )
+			fprintf( f, "\\%c", *c );
+		else if ( (unsigned char)*c < 0x20 )
+			fprintf( f, "\\u%04x", (unsigned char)*c );
+		else
+			fputc( *c, f );
+	}
+	fputc( '\"', f );
+}
+
+static const char* testTypeName( TEST_TYPE testType )
+{
+	switch ( testType )
+	{
+		case TEST_TYPE::random_pos_random_size: return "random_pos_random_size";
+		case TEST_TYPE::producer_consumer: return "producer_consumer";
+		case TEST_TYPE::trace_replay: return "trace_replay";
+		case TEST_TYPE::fast_path: return "fast_path";
+		case TEST_TYPE::load_shift: return "load_shift";
+		case TEST_TYPE::thread_churn: return "thread_churn";
+	}
+	return "unknown";
+}
+
+static const char* memAccessTypeName( MEM_ACCESS_TYPE mat )
+{
+	switch ( mat )
+	{
+		case MEM_ACCESS_TYPE::none: return "none";
+		case MEM_ACCESS_TYPE::single: return "single";
+		case MEM_ACCESS_TYPE::full: return "full";
+		case MEM_ACCESS_TYPE::check: return "check";
+	}
+	return "unknown";
+}
+
+static void writeHostMetadata( FILE* f )
+{
+	char hostName[256] = "";
+	char os[512] = "";
+	char cpuModel[256] = "";
+	size_t cpuCount = 0;
+#ifdef _MSC_VER
+	DWORD sz = sizeof( hostName );
+	GetComputerNameA( hostName, &sz );
+	sprintf( os, "Windows" );
+	SYSTEM_INFO si;
+	GetSystemInfo( &si );
+	cpuCount = si.dwNumberOfProcessors;
+#else
+	gethostname( hostName, sizeof( hostName ) - 1 );
+	struct utsname un;
+	if ( uname( &un ) == 0 )
+		snprintf( os, sizeof( os ), "%s %s %s", un.sysname, un.release, un.machine );
+	cpuCount = sysconf( _SC_NPROCESSORS_ONLN );
+	FILE* cpuinfo = fopen( "/proc/cpuinfo", "r" );
+	if ( cpuinfo )
+	{
+		char line[512];
+		while ( fgets( line, sizeof( line ), cpuinfo ) )
+			if ( strncmp( line, "model name", 10 ) == 0 )
+			{
+				const char* val = strchr( line, ':' );
+				if ( val )
+				{
+					snprintf( cpuModel, sizeof( cpuModel ), "%s", val + 2 );
+					cpuModel[ strcspn( cpuModel, "\n" ) ] = 0;
+				}
+				break;
+			}
+		fclose( cpuinfo );
+	}
+#endif
+	time_t now = time( nullptr );
+	char timeStr[64] = "";
+	strftime( timeStr, sizeof( timeStr ), "%Y-%m-%dT%H:%M:%SZ", gmtime( &now ) );
+
+	fprintf( f, "\t\"host\": {\n\t\t\"hostName\": " );
+	writeJsonString( f, hostName );
+	fprintf( f, ",\n\t\t\"os\": " );
+	writeJsonString( f, os );
+	fprintf( f, ",\n\t\t\"cpuModel\": " );
+	writeJsonString( f, cpuModel );
+	fprintf( f, ",\n\t\t\"cpuCount\": %zd,\n\t\t\"time\": ", cpuCount );
+	writeJsonString( f, timeStr );
+	fprintf( f, "\n\t},\n" );
+}
+
+static void writeStartupParams( FILE* f, const TestStartupParams& params, size_t threadCount )
+{
+	fprintf( f, "\t\t\t\"startupParams\": { \"testType\": " );
+	writeJsonString( f, testTypeName( params.testType ) );
+	fprintf( f, ", \"threadCount\": %zd, \"maxItems\": %zd, \"maxItemSizeExp\": %zd, \"iterCount\": %zd, \"memAccessType\": ", threadCount, params.maxItems, params.maxItemSize, params.iterCount );
+	writeJsonString( f, memAccessTypeName( params.mat ) );
+	fprintf( f, ", \"rndSeed\": %zd, \"collectOpLatencies\": %s", params.rndSeed, params.collectOpLatencies ? "true" : "false" );
+	if ( params.testType == TEST_TYPE::random_pos_random_size )
+		fprintf( f, ", \"idleAfterMainLoopMs\": %zd", params.idleAfterMainLoopMs );
+	if ( params.testType == TEST_TYPE::producer_consumer )
+		fprintf( f, ", \"consumerThreadCount\": %zd, \"handoffPercent\": %zd, \"handoffBatchSize\": %zd, \"handoffViaSharedRing\": %s", params.consumerThreadCount, params.handoffPercent, params.handoffBatchSize, params.handoffViaSharedRing ? "true" : "false" );
+	if ( params.testType == TEST_TYPE::trace_replay )
+	{
+		fprintf( f, ", \"traceFileName\": " );
+		writeJsonString( f, params.traceFileName );
+	}
+	fprintf( f, " },\n" );
+}
+
+static void writeLatency( FILE* f, const char* name, const LatencyPercentiles& l )
+{
+	fprintf( f, "\"%s\": { \"opCount\": %zd, \"p50\": %zd, \"p99\": %zd, \"p999\": %zd, \"p9999\": %zd, \"max\": %zd }", name, (size_t)l.opCount, (size_t)l.p50, (size_t)l.p99, (size_t)l.p999, (size_t)l.p9999, (size_t)l.max );
+}
+
+// { "<counter>": [ <setup>, <main loop>, <idle>, <exit> ], ... }
+static void writePerfCounters( FILE* f, uint32_t available, const uint64_t phaseValues[test_phase_count][perf_counter_count] )
+{
+	fprintf( f, "\"perfCounters\": {" );
+	bool first = true;
+	for ( size_t c=0; c<perf_counter_count; ++c )
+		if ( available & ( 1 << c ) )
+		{
+			fprintf( f, "%s \"%s\": [ %zd, %zd, %zd, %zd ]", first ? "" : ",", perf_counter_names[c], (size_t)phaseValues[0][c], (size_t)phaseValues[1][c], (size_t)phaseValues[2][c], (size_t)phaseValues[3][c] );
+			first = false;
+		}
+	fprintf( f, " }" );
+}
+
+static void writeThreadRes( FILE* f, const ThreadTestRes& res, bool last )
+{
+	fprintf( f, "\t\t\t\t{ \"threadID\": %zd, \"rngSeed\": \"0x%llx\", \"innerDur\": %zd, \"rdtscPhases\": [ %zd, %zd, %zd, %zd ], \"rssMax\": %zd, \"allocatedAfterSetupSz\": %zd", res.threadID, (unsigned long long)res.rngSeed, res.innerDur, (size_t)(res.rdtscSetup - res.rdtscBegin), (size_t)(res.rdtscMainLoop - res.rdtscSetup), (size_t)(res.rdtscIdle - res.rdtscMainLoop), (size_t)(res.rdtscExit - res.rdtscIdle), res.rssMax, res.allocatedAfterSetupSz );
+	if ( res.idleDur )
+	{
+		fprintf( f, ", \"idleDur\": %zd, \"rssDuringIdle\": [", res.idleDur );
+		for ( size_t i=0; i<idle_rss_sample_count; ++i )
+			fprintf( f, "%s %zd", i ? "," : "", res.rssDuringIdle[i] );
+		fprintf( f, " ]" );
+	}
+	if ( res.rssAfterTurn )
+		fprintf( f, ", \"rssAfterTurn\": %zd", res.rssAfterTurn );
+#ifdef COLLECT_USER_MAX_ALLOCATED
+	fprintf( f, ", \"allocatedMax\": %zd", res.allocatedMax );
+#endif
+	fprintf( f, ", \"mainLoopOpCount\": %zd, ", res.mainLoopOpCount );
+	uint64_t phaseValues[test_phase_count][perf_counter_count];
+	for ( size_t phase=0; phase<test_phase_count; ++phase )
+		for ( size_t c=0; c<perf_counter_count; ++c )
+			phaseValues[phase][c] = perfCounterPhaseValue( res, phase, c );
+	writePerfCounters( f, res.perfCountersAvailable, phaseValues );
+	fprintf( f, " }%s\n", last ? "" : "," );
+}
+
+static void writeRun( FILE* f, const char* allocatorName, const TestStartupParams& params, const TestRes& trMy, const TestRes& trVoid )
+{
+	fprintf( f, "\t\t{\n\t\t\t\"allocator\": " );
+	writeJsonString( f, allocatorName );
+	fprintf( f, ",\n" );
+	writeStartupParams( f, params, trMy.threadCount );
+	fprintf( f, "\t\t\t\"duration\": %zd, \"durationVoid\": %zd, \"rssBeforeTest\": %zd, \"rssMax\": %zd, \"rssAfterExitingAllThreads\": %zd, \"rssMaxVoid\": %zd, \"allocatedAfterSetupSz\": %zd", trMy.duration, trVoid.duration, trMy.rssBeforeTest, trMy.rssMax, trMy.rssAfterExitingAllThreads, trVoid.rssMax, trMy.allocatedAfterSetupSz );
+#ifdef COLLECT_USER_MAX_ALLOCATED
+	fprintf( f, ", \"allocatedMax\": %zd", trMy.allocatedMax );
+#endif
+	fprintf( f, ", \"mainLoopOpCount\": %zd,\n\t\t\t", trMy.mainLoopOpCount );
+	writeLatency( f, "allocLatency", trMy.allocLatency );
+	fprintf( f, ", " );
+	writeLatency( f, "deallocLatency", trMy.deallocLatency );
+	fprintf( f, ",\n\t\t\t" );
+	uint64_t phaseValues[test_phase_count][perf_counter_count];
+	for ( size_t phase=0; phase<test_phase_count; ++phase )
+		for ( size_t c=0; c<perf_counter_count; ++c )
+			phaseValues[phase][c] = trMy.perfPhase[phase].values[c];
+	writePerfCounters( f, trMy.perfCountersAvailable, phaseValues );
+	fprintf( f, ",\n\t\t\t\"threads\": [\n" );
+	for ( size_t i=0; i<trMy.threadCount; ++i )
+		writeThreadRes( f, trMy.threadRes[i], i + 1 == trMy.threadCount );
+	fprintf( f, "\t\t\t]\n\t\t}" );
+}
+
+bool writeTestResultsJson( const char* fileName, const AllocatorTestResults* results, size_t resultCount )
+{
+	FILE* f = fopen( fileName, "w" );
+	if ( f == nullptr )
+	{
+		printf( "failed to open \'%s\' for writing results\n", fileName );
+		return false;
+	}
+
+	fprintf( f, "{\n\t\"format\": \"allocator_tester_results\",\n\t\"version\": 1,\n" );
+	writeHostMetadata( f );
+	fprintf( f, "\t\"runs\": [\n" );
+	bool first = true;
+	for ( size_t i=0; i<resultCount; ++i )
+	{
+		if ( !results[i].succeeded )
+			continue;
+		const TestStartupParams& params = results[i].params;
+		ThreadCountSet threadCounts = results[i].threadCounts;
+		if ( params.testType == TEST_TYPE::trace_replay )
+		{
+			threadCounts = ThreadCountSet();
+			threadCounts.add( 0 );
+		}
+		for ( size_t threadCount : threadCounts )
+		{
+			TestStartupParams runParams = params;
+			if ( params.testType != TEST_TYPE::trace_replay )
+				runParams.maxItems = params.maxItems / threadCount;
+			fputs( first ? "" : ",\n", f );
+			first = false;
+			writeRun( f, results[i].allocatorName, runParams, results[i].testResMyAlloc[threadCount], results[i].testResVoidAlloc[threadCount] );
+		}
+	}
+	fprintf( f, "%s\t]\n}\n", first ? "" : "\n" );
+	bool ok = ferror( f ) == 0;
+	fclose( f );
+	if ( !ok )
+		printf( "failed to write results to \'%s\'\n", fileName );
+	return ok;
+}
+
+
+// reading (just enough JSON for files written above)
+
+struct JsonValue
+{
+	enum Type { null_value, boolean, number, string, array, object } type = null_value;
+	double num = 0;
+	std::string str;
+	std::vector<JsonValue> items;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	const JsonValue* get( const char* name ) const
+	{
+		for ( auto& m : members )
+			if ( m.first == name )
+				return &(m.second);
+		return nullptr;
+	}
+	double getNumber( const char* name ) const { const JsonValue* v = get( name ); return v && v->type == number ? v->num : 0; }
+};
+
+class JsonParser
+{
+	const char* pos;
+	const char* end;
+
+	void skipWhitespace() { while ( pos < end && ( *pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r' ) ) ++pos; }
+	bool parseString( std::string& out )
+	{
+		if ( pos == end || *pos != '\"' )
+			return false;
+		++pos;
+		while ( pos < end && *pos != '\"' )
+		{
+			if ( *pos == '\\' )
+			{
+				if ( ++pos == end )
+					return false;
+				if ( *pos == 'u' )
+				{
+					if ( end - pos < 5 )
+						return false;
+					out += (char)strtol( std::string( pos + 1, 4 ).c_str(), nullptr, 16 ); // only control characters are escaped this way
+					pos += 5;
+					continue;
+				}
+				out += *pos == 'n' ? '\n' : ( *pos == 't' ? '\t' : *pos );
+				++pos;
+			}
+			else
+				out += *pos++;
+		}
+		if ( pos == end )
+			return false;
+		++pos;
+		return true;
+	}
+
+public:
+	JsonParser( const char* data, size_t sz ) : pos( data ), end( data + sz ) {}
+
+	bool parse( JsonValue& v )
+	{
+		skipWhitespace();
+		if ( pos == end )
+			return false;
+		if ( *pos == '{' )
+		{
+			v.type = JsonValue::object;
+			++pos;
+			skipWhitespace();
+			if ( pos < end && *pos == '}' )
+				return ++pos, true;
+			for (;;)
+			{
+				std::pair<std::string, JsonValue> member;
+				skipWhitespace();
+				if ( !parseString( member.first ) )
+					return false;
+				skipWhitespace();
+				if ( pos == end || *pos++ != ':' || !parse( member.second ) )
+					return false;
+				v.members.push_back( std::move( member ) );
+				skipWhitespace();
+				if ( pos == end )
+					return false;
+				if ( *pos == '}' )
+					return ++pos, true;
+				if ( *pos++ != ',' )
+					return false;
+			}
+		}
+		if ( *pos == '[' )
+		{
+			v.type = JsonValue::array;
+			++pos;
+			skipWhitespace();
+			if ( pos < end && *pos == ']' )
+				return ++pos, true;
+			for (;;)
+			{
+				v.items.emplace_back();
+				if ( !parse( v.items.back() ) )
+					return false;
+				skipWhitespace();
+				if ( pos == end )
+					return false;
+				if ( *pos == ']' )
+					return ++pos, true;
+				if ( *pos++ != ',' )
+					return false;
+			}
+		}
+		if ( *pos == '\"' )
+		{
+			v.type = JsonValue::string;
+			return parseString( v.str );
+		}
+		if ( end - pos >= 4 && strncmp( pos, "true", 4 ) == 0 )
+		{
+			v.type = JsonValue::boolean;
+			v.num = 1;
+			return pos += 4, true;
+		}
+		if ( end - pos >= 5 && strncmp( pos, "false", 5 ) == 0 )
+		{
+			v.type = JsonValue::boolean;
+			return pos += 5, true;
+		}
+		if ( end - pos >= 4 && strncmp( pos, "null", 4 ) == 0 )
+			return pos += 4, true;
+		char* numEnd;
+		v.type = JsonValue::number;
+		v.num = strtod( pos, &numEnd );
+		if ( numEnd == pos )
+			return false;
+		pos = numEnd;
+		return true;
+	}
+};
+
+static bool readJsonFile( const char* fileName, JsonValue& root )
+{
+	FILE* f = fopen( fileName, "rb" );
+	if ( f == nullptr )
+	{
+		printf( "failed to open \'%s\'\n", fileName );
+		return false;
+	}
+	std::string data;
+	char buff[0x10000];
+	size_t cnt;
+	while ( ( cnt = fread( buff, 1, sizeof( buff ), f ) ) != 0 )
+		data.append( buff, cnt );
+	fclose( f );
+	JsonParser parser( data.c_str(), data.size() );
+	const JsonValue* format;
+	if ( !parser.parse( root ) || root.type != JsonValue::object || ( format = root.get( "format" ) ) == nullptr || format->str != "allocator_tester_results" )
+	{
+		printf( "\'%s\' is not a results file\n", fileName );
+		return false;
+	}
+	return true;
+}
+
+
+// comparison
+
+struct RunSamples
+{
+	std::vector<double> ticksPerOp; // of each run (main loop ticks of all threads over their operations), as threads of a run are not independent
+	std::vector<double> rssMax; // of each run
+};
+
+// runs differing only in a random seed are considered repetitions
+static std::string runKey( const JsonValue& run )
+{
+	const JsonValue* allocator = run.get( "allocator" );
+	std::string key = allocator ? allocator->str : "?";
+	const JsonValue* params = run.get( "startupParams" );
+	if ( params == nullptr )
+		return key;
+	for ( auto& m : params->members )
+	{
+		if ( m.first == "rndSeed" )
+			continue;
+		char buff[64];
+		if ( m.second.type == JsonValue::number || m.second.type == JsonValue::boolean )
+			snprintf( buff, sizeof( buff ), "%.17g", m.second.num ); // exact for integers, so that, say, 1000000 and 1000001 items differ
+		key += ", " + m.first + " = " + ( m.second.type == JsonValue::string ? m.second.str : std::string( buff ) );
+	}
+	return key;
+}
+
+static void collectSamples( const JsonValue& root, std::map<std::string, RunSamples>& samples )
+{
+	const JsonValue* runs = root.get( "runs" );
+	if ( runs == nullptr )
+		return;
+	for ( const JsonValue& run : runs->items )
+	{
+		RunSamples& s = samples[ runKey( run ) ];
+		s.rssMax.push_back( run.getNumber( "rssMax" ) );
+		const JsonValue* threads = run.get( "threads" );
+		if ( threads == nullptr )
+			continue;
+		double ticks = 0;
+		double ops = 0;
+		for ( const JsonValue& t : threads->items )
+		{
+			const JsonValue* phases = t.get( "rdtscPhases" );
+			double threadOps = t.getNumber( "mainLoopOpCount" );
+			if ( phases && phases->items.size() > 1 && threadOps > 0 ) // files written before the idle phase was added have fewer phases
+			{
+				ticks += phases->items[1].num;
+				ops += threadOps;
+			}
+		}
+		if ( ops > 0 )
+			s.ticksPerOp.push_back( ticks / ops );
+	}
+}
+
+struct SampleStats
+{
+	size_t n;
+	double mean;
+	double var;
+};
+
+static SampleStats calcStats( const std::vector<double>& v )
+{
+	SampleStats st = { v.size(), 0, 0 };
+	for ( double x : v )
+		st.mean += x;
+	if ( st.n )
+		st.mean /= st.n;
+	for ( double x : v )
+		st.var += ( x - st.mean ) * ( x - st.mean );
+	if ( st.n > 1 )
+		st.var /= st.n - 1;
+	return st;
+}
+
+// two-sided 95% critical values of Student's t distribution
+static double tCritical( double df )
+{
+	static const double table[30] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	if ( df < 1 )
+		return table[0];
+	if ( df <= 30 )
+		return table[ (size_t)df - 1 ];
+	return df <= 120 ? 2.0 : 1.96;
+}
+
+enum COMPARISON_VERDICT { verdict_same, verdict_better, verdict_worse, verdict_not_enough_samples };
+
+// for both metrics a greater value is worse
+static COMPARISON_VERDICT compareSamples( const std::vector<double>& base, const std::vector<double>& current, double thresholdPercent, double& changePercent )
+{
+	SampleStats b = calcStats( base );
+	SampleStats c = calcStats( current );
+	changePercent = b.mean != 0 ? ( c.mean - b.mean ) * 100. / b.mean : 0;
+	if ( fabs( changePercent ) <= thresholdPercent )
+		return verdict_same;
+	if ( b.n < 2 || c.n < 2 )
+		return verdict_not_enough_samples;
+	double se2 = b.var / b.n + c.var / c.n;
+	if ( se2 == 0 )
+		return changePercent > 0 ? verdict_worse : verdict_better; // deterministic values
+	double t = ( c.mean - b.mean ) / sqrt( se2 );
+	double df = se2 * se2 / ( ( b.var / b.n ) * ( b.var / b.n ) / ( b.n - 1 ) + ( c.var / c.n ) * ( c.var / c.n ) / ( c.n - 1 ) );
+	if ( fabs( t ) < tCritical( df ) )
+		return verdict_same;
+	return t > 0 ? verdict_worse : verdict_better;
+}
+
+static const char* verdictName( COMPARISON_VERDICT verdict )
+{
+	switch ( verdict )
+	{
+		case verdict_same: return "same";
+		case verdict_better: return "BETTER";
+		case verdict_worse: return "REGRESSION";
+		case verdict_not_enough_samples: return "changed (not enough samples to tell)";
+	}
+	return "unknown";
+}
+
+// a file, or a directory to read all *.json from
+static bool readResults( const char* path, std::vector<JsonValue>& roots )
+{
+	std::vector<std::string> fileNames;
+#ifdef _MSC_VER
+	DWORD attrs = GetFileAttributesA( path );
+	if ( attrs != INVALID_FILE_ATTRIBUTES && ( attrs & FILE_ATTRIBUTE_DIRECTORY ) )
+	{
+		WIN32_FIND_DATAA fd;
+		HANDLE h = FindFirstFileA( ( std::string( path ) + "\\*.json" ).c_str(), &fd );
+		if ( h != INVALID_HANDLE_VALUE )
+		{
+			do
+				fileNames.push_back( std::string( path ) + "\\" + fd.cFileName );
+			while ( FindNextFileA( h, &fd ) );
+			FindClose( h );
+		}
+	}
+#else
+	struct stat st;
+	if ( stat( path, &st ) == 0 && S_ISDIR( st.st_mode ) )
+	{
+		DIR* dir = opendir( path );
+		if ( dir != nullptr )
+		{
+			while ( struct dirent* de = readdir( dir ) )
+			{
+				size_t len = strlen( de->d_name );
+				if ( len > 5 && strcmp( de->d_name + len - 5, ".json" ) == 0 )
+					fileNames.push_back( std::string( path ) + "/" + de->d_name );
+			}
+			closedir( dir );
+		}
+	}
+#endif
+	else
+		fileNames.push_back( path );
+	if ( fileNames.empty() )
+	{
+		printf( "no results in \'%s\'\n", path );
+		return false;
+	}
+	for ( auto& fileName : fileNames )
+	{
+		roots.emplace_back();
+		if ( !readJsonFile( fileName.c_str(), roots.back() ) )
+			return false;
+	}
+	return true;
+}
+
+static const char* cpuModel( const JsonValue& root )
+{
+	const JsonValue* host = root.get( "host" );
+	const JsonValue* cpu = host ? host->get( "cpuModel" ) : nullptr;
+	return cpu ? cpu->str.c_str() : nullptr;
+}
+
+int compareTestResults( const char* baseName, const char* newName, double thresholdPercent )
+{
+	std::vector<JsonValue> baseRoots, newRoots;
+	if ( !readResults( baseName, baseRoots ) || !readResults( newName, newRoots ) )
+		return -1;
+
+	const char* baseCpu = cpuModel( baseRoots[0] );
+	for ( auto& roots : { &baseRoots, &newRoots } )
+		for ( const JsonValue& root : *roots )
+		{
+			const char* cpu = cpuModel( root );
+			if ( baseCpu && cpu && strcmp( baseCpu, cpu ) != 0 )
+			{
+				printf( "WARNING: results were obtained on different CPUs (\'%s\' vs \'%s\')\n", baseCpu, cpu );
+				baseCpu = nullptr; // warn once
+			}
+		}
+
+	std::map<std::string, RunSamples> baseSamples, newSamples;
+	for ( const JsonValue& root : baseRoots )
+		collectSamples( root, baseSamples );
+	for ( const JsonValue& root : newRoots )
+		collectSamples( root, newSamples );
+
+	int regressions = 0;
+	printf( "Comparison of \'%s\' (base) and \'%s\' (threshold %.1f%%):\n", baseName, newName, thresholdPercent );
+	printf( "columns:\n" );
+	printf( "run,base ticks/op,ticks/op,change(%%),throughput verdict,base RSS max(pages),RSS max(pages),change(%%),RSS verdict\n" );
+	for ( auto& it : newSamples )
+	{
+		auto baseIt = baseSamples.find( it.first );
+		if ( baseIt == baseSamples.end() )
+		{
+			printf( "\"%s\",,,,no base run\n", it.first.c_str() );
+			continue;
+		}
+		double ticksChange, rssChange;
+		COMPARISON_VERDICT ticksVerdict = compareSamples( baseIt->second.ticksPerOp, it.second.ticksPerOp, thresholdPercent, ticksChange );
+		COMPARISON_VERDICT rssVerdict = compareSamples( baseIt->second.rssMax, it.second.rssMax, thresholdPercent, rssChange );
+		regressions += ( ticksVerdict == verdict_worse ) + ( rssVerdict == verdict_worse );
+		printf( "\"%s\",%.2f,%.2f,%+.2f,%s,%.0f,%.0f,%+.2f,%s\n", it.first.c_str(), calcStats( baseIt->second.ticksPerOp ).mean, calcStats( it.second.ticksPerOp ).mean, ticksChange, verdictName( ticksVerdict ), calcStats( baseIt->second.rssMax ).mean, calcStats( it.second.rssMax ).mean, rssChange, verdictName( rssVerdict ) );
+	}
+	for ( auto& it : baseSamples )
+		if ( newSamples.find( it.first ) == newSamples.end() )
+			printf( "\"%s\",,,,no new run\n", it.first.c_str() );
+	printf( "%d regression(s) found\n", regressions );
+	return regressions;
+}
@@ -0,0 +1,59 @@
+/* -------------------------------------------------------------------------------
+ * Copyright (c) 2018, OLogN Technologies AG
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * -------------------------------------------------------------------------------
+ * 
+ * Memory allocator tester -- machine-readable results and their comparison
+ * 
+ * v.1.00    Oct-17-2026    Initial release
+ * 
+ * -------------------------------------------------------------------------------*/
+
+
+#ifndef ALLOCATOR_TEST_RESULTS_H
+#define ALLOCATOR_TEST_RESULTS_H
+
+#include "test_common.h"
+
+struct AllocatorTestResults
+{
+	const char* allocatorName;
+	TestStartupParams params; // maxItems is a total for all threads, as it is split between threads in a run
+	ThreadCountSet threadCounts; // ignored for trace_replay
+	bool succeeded;
+	const TestRes* testResMyAlloc; // [max_threads], indexed by a number of threads (by 0 for trace_replay)
+	const TestRes* testResVoidAlloc;
+};
+
+// JSON: host metadata and a list of runs, each with its startup parameters, totals, per-phase counters and per-thread stats
+bool writeTestResultsJson( const char* fileName, const AllocatorTestResults* results, size_t resultCount );
+
+// base and new are result files or directories of them (all *.json there are merged);
+// runs are matched by an allocator, startup parameters and a number of threads; repeated runs are merged;
+// throughput (main loop CPU ticks per operation of each thread) and RSS max are compared with Welch's t-test (two-sided, 95%);
+// a regression is a significant change exceeding thresholdPercent; returns a number of regressions, or -1 if files cannot be read
+int compareTestResults( const char* baseName, const char* newName, double thresholdPercent );
+
+#endif // ALLOCATOR_TEST_RESULTS_H